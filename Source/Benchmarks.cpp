@@ -0,0 +1,247 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "Benchmarks.h"
+#include "./NEAT/NEAT.h"
+#include "./NEAT/MathHelpers.h"
+#include "./NEAT/NetworkModel.h"
+#include "./NEAT/Random.h"
+#include "./NEAT/TypedNetwork.h"
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+static volatile float sink = 0; // keeps the compiler from dropping the work being timed
+
+// average time of a call to f in nanoseconds
+template<typename F>
+static double TimeNs(int reps, F f) {
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < reps; ++i) {
+		f(i);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / reps;
+}
+
+// champion of a short evolution that rewards size (so the network has some hidden nodes to evaluate)
+static NetworkBase EvolveNetwork(int num_inputs, int num_outputs, int generations) {
+	NEATRandom::SetSeed(1);
+	NEAT neat(num_inputs, num_outputs, 150, 1.5f, 1.f, 0.4f, 0.6f, 0.1f, 0.5f, 0.8f);
+	for (int generation = 0; generation < generations; ++generation) {
+		auto networks = neat.GenerateLeanNetworks();
+		for (auto& e : networks) {
+			std::get<1>(e).SetFitness(std::get<0>(e).GetNumEdges());
+		}
+		neat.UpdateGeneration();
+	}
+
+	auto networks = neat.GenerateLeanNetworks();
+	int best = 0;
+	for (int i = 1; i < (int)networks.size(); ++i) {
+		if (std::get<0>(networks[i]).GetNumEdges() > std::get<0>(networks[best]).GetNumEdges()) best = i;
+	}
+	return std::get<0>(networks[best]);
+}
+
+void Benchmarks::RunOverhead() {
+	const int reps = 200000;
+	const int rounds = 11;
+	const NetworkBase evolved = EvolveNetwork(4, 2, 30);
+	NetworkModel model(evolved);
+
+	// the timings depend on where the buffers land (separate buffers made one path up to 30% slower here, in whichever order it ran),
+	// so every path uses the same in and out buffers, every round allocates everything again at a different offset,
+	// and the paths take turns, starting with a different one every round
+	// round 0 only warms up, and the median of the other rounds is reported
+	std::vector<double> times[3];
+	for (int round = 0; round <= rounds; ++round) {
+		std::vector<char> offset(1 + 200 * round);
+		NetworkBase network = evolved; // (allocates its own node values)
+		NetworkState state(model);
+		std::vector<float> in = { 0.f, 0.5f, -0.25f, 1.f };
+		std::vector<float> out(2);
+		float(&fixedIn)[4] = *reinterpret_cast<float(*)[4]>(in.data());
+		float(&fixedOut)[2] = *reinterpret_cast<float(*)[2]>(out.data());
+		NetworkBinding binding;
+		FixedNetworkBinding<4, 2> fixedBinding;
+		if (binding.Bind(model, state, 4, 2) != NetworkStatus::Ok || fixedBinding.Bind(model, state) != NetworkStatus::Ok) {
+			std::cerr << "RunOverhead failed to bind the network" << std::endl;
+			return;
+		}
+
+		for (int k = 0; k < 3; ++k) {
+			const int path = (round + k) % 3;
+			double ns = 0;
+			if (path == 0) {
+				ns = TimeNs(reps, [&](int i) {
+					in[0] = (float)(i & 1);
+					network.Run(in, out);
+					sink = sink + out[0];
+				});
+			}
+			else if (path == 1) {
+				ns = TimeNs(reps, [&](int i) {
+					in[0] = (float)(i & 1);
+					binding.Run(in.data(), out.data());
+					sink = sink + out[0];
+				});
+			}
+			else {
+				ns = TimeNs(reps, [&](int i) {
+					in[0] = (float)(i & 1);
+					fixedBinding.Run(fixedIn, fixedOut);
+					sink = sink + out[0];
+				});
+			}
+			if (round > 0) times[path].emplace_back(ns);
+		}
+	}
+	for (auto& e : times) {
+		std::sort(e.begin(), e.end());
+	}
+
+	std::cout << "RunOverhead (" << evolved.GetNumNodes() << " nodes, " << evolved.GetNumEdges() << " edges, median of " << rounds << " rounds): NetworkBase::Run "
+		<< times[0][rounds / 2] << " ns, NetworkBinding::Run " << times[1][rounds / 2] << " ns, FixedNetworkBinding::Run " << times[2][rounds / 2] << " ns per call" << std::endl;
+}
+
+// runs network through the rollout and returns the time per run (outputs are appended to outputs)
+template<typename NetworkType>
+static double RunRollout(NetworkType& network, int num_inputs, int num_outputs, int steps, std::vector<double>& outputs) {
+	std::vector<float> in(num_inputs);
+	std::vector<double> out(num_outputs);
+	outputs.clear();
+	outputs.reserve((size_t)steps * num_outputs);
+	network.ResetRecurrentConnections();
+	return TimeNs(steps, [&](int step) {
+		for (int i = 0; i < num_inputs; ++i) {
+			in[i] = std::sin(step * 0.01f + i);
+		}
+		network.Run(in, out);
+		outputs.insert(outputs.end(), out.begin(), out.end());
+	});
+}
+
+template<typename Weight, typename Value>
+static void PrintTypedNetwork(const char* name, const NetworkBase& network, int num_inputs, int num_outputs, int steps, const std::vector<double>& reference) {
+	TypedNetwork<Weight, Value> typed(network);
+	std::vector<double> outputs;
+	const double ns = RunRollout(typed, num_inputs, num_outputs, steps, outputs);
+	// recurrent rollouts can be chaotic, so small errors eventually grow; report how long the outputs stay close as well
+	const int closeSteps = 100;
+	double maxDiff = 0;
+	int divergedStep = -1; // first step with an output more than 0.01 away
+	for (size_t i = 0; i < outputs.size(); ++i) {
+		const double diff = std::abs(outputs[i] - reference[i]);
+		const int step = i / num_outputs;
+		if (step < closeSteps) maxDiff = std::max(maxDiff, diff);
+		if (diff > 0.01 && divergedStep < 0) divergedStep = step;
+	}
+	std::cout << "  " << name << ": " << ns << " ns per run, " << typed.GetNumWeightBytes() << " weight bytes, max difference from <double, double> over the first "
+		<< closeSteps << " steps " << maxDiff << ", " << (divergedStep < 0 ? std::string("never diverged") : "diverged at step " + std::to_string(divergedStep)) << std::endl;
+}
+
+void Benchmarks::TypedNetworks() {
+	const int numInputs = 8;
+	const int numOutputs = 4;
+	const int steps = 20000;
+	const NetworkBase network = EvolveNetwork(numInputs, numOutputs, 60);
+
+	std::vector<double> reference;
+	TypedNetwork<double, double> doubleNetwork(network);
+	RunRollout(doubleNetwork, numInputs, numOutputs, steps, reference);
+
+	std::cout << "TypedNetworks (" << network.GetNumNodes() << " nodes, " << network.GetNumEdges() << " edges, " << steps << " recurrent steps):" << std::endl;
+	PrintTypedNetwork<float, float>("<float, float>", network, numInputs, numOutputs, steps, reference);
+	PrintTypedNetwork<double, double>("<double, double>", network, numInputs, numOutputs, steps, reference);
+	PrintTypedNetwork<NEATHalf, float>("<NEATHalf, float>", network, numInputs, numOutputs, steps, reference);
+}
+
+// adds node and edge mutations until the genome has at least num_genes genes (neat numbers the new nodes)
+static void GrowGenome(Genome& genome, NEAT& neat, int num_genes) {
+	while (genome.GetNumGenes() < num_genes) {
+		if (NEATMathHelpers::rand_int(4) == 0) genome.AddNodeMutation(neat);
+		else genome.AddEdgeMutation(1);
+	}
+}
+
+void Benchmarks::GenomeOperations() {
+	const int numInputs = 8;
+	const int numOutputs = 4;
+	std::cout << "GenomeOperations:" << std::endl;
+	for (int numGenes : { 10, 100, 1000, 10000 }) {
+		NEATRandom::SetSeed(numGenes);
+		NEAT neat(numInputs, numOutputs, 1); // (only used for numbering the new nodes)
+		Genome parent1(numInputs + 1, numOutputs);
+		parent1.AddInputOutputEdge(1);
+		GrowGenome(parent1, neat, numGenes);
+		Genome parent2 = parent1; // related parents (as in a specie) that have diverged a bit
+		GrowGenome(parent2, neat, parent1.GetNumGenes() + numGenes / 10 + 1);
+		parent2.MutateWeights(0.1f, 2.f, 0.1f);
+
+		const int reps = std::max(20, 200000 / numGenes);
+		const double copyNs = TimeNs(reps, [&](int) {
+			Genome copy = parent1;
+			sink = sink + copy.GetNumGenes();
+		});
+		const double crossoverNs = TimeNs(reps, [&](int) {
+			Genome child = parent1;
+			child.Crossover(parent2);
+			sink = sink + child.GetNumGenes();
+		});
+		const double distanceNs = TimeNs(reps, [&](int) {
+			sink = sink + parent1.GetCompatibilityDist(parent2, 1.f, 0.4f, 1e30f); // (no early exit)
+		});
+
+		std::cout << "  " << parent1.GetNumGenes() << " genes: copy " << copyNs / 1000 << " us, copy + Crossover " << crossoverNs / 1000
+			<< " us, GetCompatibilityDist " << distanceNs / 1000 << " us" << std::endl;
+	}
+}
+
+void Benchmarks::NetworkCompile() {
+	const int numInputs = 8;
+	const int numOutputs = 4;
+	std::cout << "NetworkCompile:" << std::endl;
+	for (int numGenes : { 10, 100, 1000, 10000 }) {
+		NEATRandom::SetSeed(numGenes);
+		NEAT neat(numInputs, numOutputs, 1); // (only used for numbering the new nodes)
+		Genome genome(numInputs + 1, numOutputs);
+		genome.AddInputOutputEdge(1);
+		GrowGenome(genome, neat, numGenes);
+
+		const int reps = std::max(20, 200000 / numGenes);
+		const double networkNs = TimeNs(reps, [&](int) {
+			const auto network = genome.GenerateNetwork();
+			sink = sink + network.GetNumEdges();
+		});
+		const double networkBaseNs = TimeNs(reps, [&](int) {
+			const auto network = genome.GenerateNetworkBase();
+			sink = sink + network.GetNumEdges();
+		});
+
+		std::cout << "  " << genome.GetNumGenes() << " genes: GenerateNetwork " << networkNs / 1000
+			<< " us, GenerateNetworkBase " << networkBaseNs / 1000 << " us" << std::endl;
+	}
+}
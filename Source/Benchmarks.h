@@ -0,0 +1,34 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+// benchmarks of the NEAT module (results are printed to std::cout, so build with optimizations turned on)
+// every benchmark seeds NEATRandom itself, so the networks and genomes it measures are the same from run to run
+namespace Benchmarks {
+	void RunOverhead(); // per call cost of NetworkBase::Run versus NetworkBinding::Run and FixedNetworkBinding::Run
+	void TypedNetworks(); // time per run and drift from <double, double> over a long recurrent rollout for each TypedNetwork instantiation
+	void GenomeOperations(); // genome copy, Crossover and GetCompatibilityDist at 10, 100, 1000 and 10000 genes
+	void NetworkCompile(); // Genome::GenerateNetwork and GenerateNetworkBase at 10, 100, 1000 and 10000 genes
+}
@@ -0,0 +1,171 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "ExportTest.h"
+#include "./NEAT/NEAT.h"
+#include "./NEAT/NetworkModel.h"
+#include "./NEAT/Random.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#if defined(__has_include)
+#if __has_include("ExportTestNetwork.h") && __has_include("ExportTestNetworkHalf.h") && __has_include("ExportTestNetworkSpecial.h")
+#include "ExportTestNetwork.h"
+#include "ExportTestNetworkHalf.h"
+#include "ExportTestNetworkSpecial.h"
+#define EXPORT_TEST_HAS_HEADERS
+#endif
+#endif
+
+static const int NUM_INPUTS = 3;
+static const int NUM_OUTPUTS = 2;
+static const int NUM_STEPS = 200;
+
+// gives the hidden and output nodes every activation in turn
+static void MixActivations(NetworkBase& network) {
+	for (int i = NUM_INPUTS + 1; i < network.GetNumNodes(); ++i) {
+		network.SetNodeActivation(i, (NEATActivation::Type)(i % (int)NEATActivation::Type::Count));
+	}
+}
+
+// writes a network without hidden nodes in the original file layout, with weights that don't have plain decimal literals
+// (inf, NaN, subnormals, -0 and the extremes of float); the second output ends up NaN
+static bool WriteSpecialWeightsNetwork(const char* fname) {
+	struct Edge { int input_index; float weight; }; // (same layout as NetworkBase::NeuronInputInfo and NeuronRunInfo)
+	struct RunInfo { float output_val; int input_info_block_size; };
+	const float inf = std::numeric_limits<float>::infinity();
+	const int numNodes = NUM_INPUTS + 1 + NUM_OUTPUTS;
+	const Edge edges[] = {
+		{ 0, 0.1f }, { 1, -3.5f }, { 2, std::numeric_limits<float>::denorm_min() }, { 3, FLT_MIN }, // first output (bias is node 3)
+		{ 0, -0.f }, { 1, FLT_MAX }, { 2, -inf }, { 3, std::numeric_limits<float>::quiet_NaN() } // second output
+	};
+	const int numEdges = sizeof(edges) / sizeof(edges[0]);
+	const int outputIndices[NUM_OUTPUTS] = { NUM_INPUTS + 1, NUM_INPUTS + 2 };
+	const int identity = (int)NEATActivation::Type::Identity << 24; // (the top byte of input_info_block_size holds the activation)
+	RunInfo runInfo[numNodes] = {};
+	runInfo[NUM_INPUTS + 1].input_info_block_size = identity | 4;
+	runInfo[NUM_INPUTS + 2].input_info_block_size = identity | 4;
+
+	std::ofstream file{ fname, std::ios::binary };
+	const int header[] = { NUM_INPUTS + 1, NUM_OUTPUTS, numEdges, NUM_OUTPUTS, numNodes };
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)edges, sizeof(edges));
+	file.write((const char*)outputIndices, sizeof(outputIndices));
+	file.write((const char*)runInfo, sizeof(runInfo));
+	return file.good();
+}
+
+bool ExportTest::Generate(const char* dir) {
+	const std::string path = dir;
+	if (!WriteSpecialWeightsNetwork((path + "/ExportTestSpecial.dat").c_str())) {
+		std::cerr << "ExportTest::Generate failed to write " << path << "/ExportTestSpecial.dat" << std::endl;
+		return false;
+	}
+	NetworkBase specialNetwork((path + "/ExportTestSpecial.dat").c_str());
+	if (specialNetwork.IsInvalid() || !specialNetwork.ExportHeader((path + "/ExportTestNetworkSpecial.h").c_str(), "ExportTestNetworkSpecial")) return false;
+
+	NEATRandom::SetSeed(5);
+	NEAT neat(NUM_INPUTS, NUM_OUTPUTS, 150, 1.5f, 1.f, 0.4f, 0.6f, 0.2f, 0.5f, 0.8f);
+
+	// reward size and recurrent connections so that the network exercises every part of the exporter
+	for (int generation = 0; generation < 300; ++generation) {
+		auto networks = neat.GenerateNetworks();
+		for (auto& e : networks) {
+			NetworkBaseVisual& network = std::get<0>(e);
+			const int numStateNodes = NetworkModel(network).GetStateSize();
+			if (numStateNodes >= 2 && network.GetNumNodes() >= 16) {
+				MixActivations(network);
+				NetworkBaseVisual halfNetwork = network;
+				halfNetwork.SetHalfPrecisionWeights(true);
+				return network.Save((path + "/ExportTestNetwork.dat").c_str()) &&
+					network.ExportHeader((path + "/ExportTestNetwork.h").c_str(), "ExportTestNetwork") &&
+					halfNetwork.ExportHeader((path + "/ExportTestNetworkHalf.h").c_str(), "ExportTestNetworkHalf");
+			}
+			std::get<1>(e).SetFitness(network.GetNumEdges() + 4.f * numStateNodes);
+		}
+		neat.UpdateGeneration();
+	}
+
+	std::cerr << "ExportTest::Generate failed to evolve a network with enough recurrent connections" << std::endl;
+	return false;
+}
+
+#ifdef EXPORT_TEST_HAS_HEADERS
+// runs the network and the generated struct side by side and counts the outputs that differ in any bit
+template<typename Generated>
+static int CountMismatches(NetworkBase& network, Generated& generated) {
+	if (network.GetNumOutputNodes() != Generated::num_outputs) return NUM_STEPS * NUM_OUTPUTS;
+
+	network.ResetRecurrentConnections();
+	generated.ResetRecurrentConnections();
+	std::vector<float> in(NUM_INPUTS);
+	std::vector<float> out(NUM_OUTPUTS);
+	float generatedIn[NUM_INPUTS];
+	float generatedOut[NUM_OUTPUTS];
+	int mismatches = 0;
+	for (int step = 0; step < NUM_STEPS; ++step) {
+		for (int i = 0; i < NUM_INPUTS; ++i) {
+			in[i] = 2 * std::sin(step * 0.37f + i * 1.3f);
+			generatedIn[i] = in[i];
+		}
+		network.Run(in, out);
+		generated.Run(generatedIn, generatedOut);
+		for (int i = 0; i < NUM_OUTPUTS; ++i) {
+			if (memcmp(&out[i], &generatedOut[i], sizeof(float)) != 0) ++mismatches;
+		}
+	}
+	return mismatches;
+}
+#endif
+
+bool ExportTest::Check(const char* dir) {
+#ifdef EXPORT_TEST_HAS_HEADERS
+	NetworkBase network((std::string(dir) + "/ExportTestNetwork.dat").c_str());
+	if (network.IsInvalid()) return false;
+	NetworkBase halfNetwork = network;
+	halfNetwork.SetHalfPrecisionWeights(true);
+
+	NetworkBase specialNetwork((std::string(dir) + "/ExportTestSpecial.dat").c_str());
+	if (specialNetwork.IsInvalid()) return false;
+
+	ExportTestNetwork generated;
+	ExportTestNetworkHalf generatedHalf;
+	ExportTestNetworkSpecial generatedSpecial;
+	const int mismatches = CountMismatches(network, generated);
+	const int halfMismatches = CountMismatches(halfNetwork, generatedHalf);
+	const int specialMismatches = CountMismatches(specialNetwork, generatedSpecial);
+	std::cout << "ExportTest: " << network.GetNumNodes() << " nodes, " << ExportTestNetwork::num_state << " recurrent state nodes, "
+		<< NUM_STEPS << " steps, " << mismatches << " mismatches (" << halfMismatches << " with half precision weights, "
+		<< specialMismatches << " with inf, NaN and subnormal weights)" << std::endl;
+	return mismatches == 0 && halfMismatches == 0 && specialMismatches == 0;
+#else
+	std::cerr << "ExportTest::Check needs the headers written by ExportTest::Generate into " << dir << " (rebuild after generating them)" << std::endl;
+	return false;
+#endif
+}
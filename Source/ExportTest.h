@@ -0,0 +1,37 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+// checks that the headers written by NetworkBase::ExportHeader give bit-identical outputs to NetworkBase::Run
+// the headers have to be compiled in, so this takes two builds:
+// 1. call ExportTest::Generate, which evolves a network with recurrent connections, gives its nodes a mix of activations,
+//    and writes ExportTestNetwork.h, ExportTestNetworkHalf.h (half precision weights) and ExportTestNetwork.dat into dir
+//    (along with ExportTestNetworkSpecial.h and ExportTestSpecial.dat, a small network with inf, NaN and subnormal weights)
+// 2. rebuild with dir on the include path (ExportTest.cpp includes the headers once they exist) and call ExportTest::Check
+// the generated code has to be compiled without contracting multiply-adds into FMAs (see NetworkBase::ExportHeader)
+namespace ExportTest {
+	bool Generate(const char* dir); // returns false if no suitable network was found or a file couldn't be written
+	bool Check(const char* dir); // returns true if every output of every step matches bit for bit
+}
@@ -0,0 +1,254 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "Activation.h"
+#include "SIMD.h"
+#include <cmath>
+
+// inputs are clamped to this range before approximating tanh (the approximation reaches 1 around here)
+static const float FAST_TANH_CLAMP = 4.97f;
+
+template<typename T>
+static inline T Clamp(T val, T min_val, T max_val) {
+	if (val < min_val) return min_val;
+	if (val > max_val) return max_val;
+	return val;
+}
+
+// [7/6] Pade approximation of tanh
+template<typename T>
+static inline T FastTanh(T val) {
+	const T x = Clamp<T>(val, -FAST_TANH_CLAMP, FAST_TANH_CLAMP);
+	const T x2 = x * x;
+	const T p = x * (T(135135) + x2 * (T(17325) + x2 * (T(378) + x2)));
+	const T q = T(135135) + x2 * (T(62370) + x2 * (T(3150) + x2 * T(28)));
+	return Clamp<T>(p / q, -1, 1);
+}
+
+template<typename T>
+static inline T ApplyScalar(NEATActivation::Type type, T val) {
+	switch (type) {
+	case NEATActivation::Type::Tanh: return std::tanh(val);
+	case NEATActivation::Type::FastTanh: return FastTanh(val);
+	case NEATActivation::Type::Sigmoid: return T(1) / (T(1) + std::exp(-val));
+	case NEATActivation::Type::ReLU: return (val > 0) ? val : T(0);
+	case NEATActivation::Type::ClampedLinear: return Clamp<T>(val, -1, 1);
+	default: return val; // Identity
+	}
+}
+
+float NEATActivation::Apply(Type type, float val) {
+	return ApplyScalar(type, val);
+}
+
+double NEATActivation::Apply(Type type, double val) {
+	return ApplyScalar(type, val);
+}
+
+bool NEATActivation::IsBounded(Type type) {
+	return type == Type::Tanh || type == Type::FastTanh || type == Type::Sigmoid || type == Type::ClampedLinear;
+}
+
+// each vector kernel processes as many whole vectors as fit and returns the number of values it handled
+// the remaining values are handled by the scalar code in ApplyBlock
+
+#ifdef NEAT_SIMD_X86
+NEAT_TARGET_AVX2 static int ApplyAVX2(NEATActivation::Type type, float* vals, int count) {
+	using NEATActivation::Type;
+	int i = 0;
+	switch (type) {
+	case Type::FastTanh: {
+		const __m256 clampVal = _mm256_set1_ps(FAST_TANH_CLAMP);
+		const __m256 one = _mm256_set1_ps(1.f);
+		for (; i + 8 <= count; i += 8) {
+			__m256 x = _mm256_loadu_ps(vals + i);
+			x = _mm256_min_ps(_mm256_max_ps(x, _mm256_sub_ps(_mm256_setzero_ps(), clampVal)), clampVal);
+			const __m256 x2 = _mm256_mul_ps(x, x);
+			__m256 p = _mm256_add_ps(_mm256_set1_ps(378.f), x2);
+			p = _mm256_add_ps(_mm256_set1_ps(17325.f), _mm256_mul_ps(x2, p));
+			p = _mm256_add_ps(_mm256_set1_ps(135135.f), _mm256_mul_ps(x2, p));
+			p = _mm256_mul_ps(x, p);
+			__m256 q = _mm256_add_ps(_mm256_set1_ps(3150.f), _mm256_mul_ps(x2, _mm256_set1_ps(28.f)));
+			q = _mm256_add_ps(_mm256_set1_ps(62370.f), _mm256_mul_ps(x2, q));
+			q = _mm256_add_ps(_mm256_set1_ps(135135.f), _mm256_mul_ps(x2, q));
+			const __m256 y = _mm256_div_ps(p, q);
+			_mm256_storeu_ps(vals + i, _mm256_min_ps(_mm256_max_ps(y, _mm256_sub_ps(_mm256_setzero_ps(), one)), one));
+		}
+		break;
+	}
+	case Type::ReLU: {
+		const __m256 zero = _mm256_setzero_ps();
+		for (; i + 8 <= count; i += 8) {
+			_mm256_storeu_ps(vals + i, _mm256_max_ps(_mm256_loadu_ps(vals + i), zero));
+		}
+		break;
+	}
+	case Type::ClampedLinear: {
+		const __m256 one = _mm256_set1_ps(1.f);
+		const __m256 negOne = _mm256_set1_ps(-1.f);
+		for (; i + 8 <= count; i += 8) {
+			_mm256_storeu_ps(vals + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(vals + i), negOne), one));
+		}
+		break;
+	}
+	default: break;
+	}
+	return i;
+}
+
+static int ApplySSE(NEATActivation::Type type, float* vals, int count) {
+	using NEATActivation::Type;
+	int i = 0;
+	switch (type) {
+	case Type::FastTanh: {
+		const __m128 clampVal = _mm_set1_ps(FAST_TANH_CLAMP);
+		const __m128 one = _mm_set1_ps(1.f);
+		for (; i + 4 <= count; i += 4) {
+			__m128 x = _mm_loadu_ps(vals + i);
+			x = _mm_min_ps(_mm_max_ps(x, _mm_sub_ps(_mm_setzero_ps(), clampVal)), clampVal);
+			const __m128 x2 = _mm_mul_ps(x, x);
+			__m128 p = _mm_add_ps(_mm_set1_ps(378.f), x2);
+			p = _mm_add_ps(_mm_set1_ps(17325.f), _mm_mul_ps(x2, p));
+			p = _mm_add_ps(_mm_set1_ps(135135.f), _mm_mul_ps(x2, p));
+			p = _mm_mul_ps(x, p);
+			__m128 q = _mm_add_ps(_mm_set1_ps(3150.f), _mm_mul_ps(x2, _mm_set1_ps(28.f)));
+			q = _mm_add_ps(_mm_set1_ps(62370.f), _mm_mul_ps(x2, q));
+			q = _mm_add_ps(_mm_set1_ps(135135.f), _mm_mul_ps(x2, q));
+			const __m128 y = _mm_div_ps(p, q);
+			_mm_storeu_ps(vals + i, _mm_min_ps(_mm_max_ps(y, _mm_sub_ps(_mm_setzero_ps(), one)), one));
+		}
+		break;
+	}
+	case Type::ReLU: {
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(vals + i, _mm_max_ps(_mm_loadu_ps(vals + i), zero));
+		}
+		break;
+	}
+	case Type::ClampedLinear: {
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 negOne = _mm_set1_ps(-1.f);
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(vals + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(vals + i), negOne), one));
+		}
+		break;
+	}
+	default: break;
+	}
+	return i;
+}
+#endif
+
+#ifdef NEAT_SIMD_NEON
+static int ApplyNEON(NEATActivation::Type type, float* vals, int count) {
+	using NEATActivation::Type;
+	int i = 0;
+	switch (type) {
+	case Type::FastTanh: {
+		const float32x4_t clampVal = vdupq_n_f32(FAST_TANH_CLAMP);
+		const float32x4_t negClampVal = vdupq_n_f32(-FAST_TANH_CLAMP);
+		const float32x4_t one = vdupq_n_f32(1.f);
+		const float32x4_t negOne = vdupq_n_f32(-1.f);
+		for (; i + 4 <= count; i += 4) {
+			float32x4_t x = vminq_f32(vmaxq_f32(vld1q_f32(vals + i), negClampVal), clampVal);
+			const float32x4_t x2 = vmulq_f32(x, x);
+			float32x4_t p = vaddq_f32(vdupq_n_f32(378.f), x2);
+			p = vaddq_f32(vdupq_n_f32(17325.f), vmulq_f32(x2, p));
+			p = vaddq_f32(vdupq_n_f32(135135.f), vmulq_f32(x2, p));
+			p = vmulq_f32(x, p);
+			float32x4_t q = vaddq_f32(vdupq_n_f32(3150.f), vmulq_f32(x2, vdupq_n_f32(28.f)));
+			q = vaddq_f32(vdupq_n_f32(62370.f), vmulq_f32(x2, q));
+			q = vaddq_f32(vdupq_n_f32(135135.f), vmulq_f32(x2, q));
+			const float32x4_t y = vdivq_f32(p, q);
+			vst1q_f32(vals + i, vminq_f32(vmaxq_f32(y, negOne), one));
+		}
+		break;
+	}
+	case Type::ReLU: {
+		const float32x4_t zero = vdupq_n_f32(0.f);
+		for (; i + 4 <= count; i += 4) {
+			vst1q_f32(vals + i, vmaxq_f32(vld1q_f32(vals + i), zero));
+		}
+		break;
+	}
+	case Type::ClampedLinear: {
+		const float32x4_t one = vdupq_n_f32(1.f);
+		const float32x4_t negOne = vdupq_n_f32(-1.f);
+		for (; i + 4 <= count; i += 4) {
+			vst1q_f32(vals + i, vminq_f32(vmaxq_f32(vld1q_f32(vals + i), negOne), one));
+		}
+		break;
+	}
+	default: break;
+	}
+	return i;
+}
+#endif
+
+typedef int (*VectorKernel)(NEATActivation::Type type, float* vals, int count);
+
+static int ApplyNone(NEATActivation::Type, float*, int) {
+	return 0; // everything is handled by the scalar code
+}
+
+// picks the vector kernel on first use (thread-safe since C++11 static initialization)
+static VectorKernel GetVectorKernel() {
+	static const VectorKernel kernel = []() -> VectorKernel {
+		switch (NEATSIMD::GetLevel()) {
+#ifdef NEAT_SIMD_X86
+		case NEATSIMD::Level::AVX2: return ApplyAVX2;
+		case NEATSIMD::Level::SSE: return ApplySSE;
+#endif
+#ifdef NEAT_SIMD_NEON
+		case NEATSIMD::Level::NEON: return ApplyNEON;
+#endif
+		default: return ApplyNone;
+		}
+	}();
+	return kernel;
+}
+
+void NEATActivation::ApplyBlock(Type type, float* vals, int count) {
+	switch (type) {
+	case Type::Identity:
+		return;
+	case Type::Tanh:
+		for (int i = 0; i < count; ++i) vals[i] = std::tanh(vals[i]);
+		return;
+	case Type::Sigmoid:
+		for (int i = 0; i < count; ++i) vals[i] = 1.f / (1.f + std::exp(-vals[i]));
+		return;
+	default:
+		break;
+	}
+
+	for (int i = GetVectorKernel()(type, vals, count); i < count; ++i) {
+		vals[i] = Apply(type, vals[i]);
+	}
+}
+
+const char* NEATActivation::GetKernelName() {
+	return NEATSIMD::GetLevelName(NEATSIMD::GetLevel());
+}
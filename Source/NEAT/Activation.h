@@ -0,0 +1,54 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+namespace NEATActivation {
+	// activation function applied to the weighted sum of a neuron
+	// values are stored per node in saved networks, so existing values shouldn't be reordered
+	enum class Type : unsigned char {
+		Tanh = 0, // default activation for hidden and output nodes
+		FastTanh, // rational approximation of tanh (max abs error ~1e-4), vectorized
+		Sigmoid,
+		ReLU,
+		Identity, // used for input nodes (including bias)
+		ClampedLinear, // identity clamped between -1 and 1
+		Count
+	};
+
+	// applies the activation to a single value
+	float Apply(Type type, float val);
+	double Apply(Type type, double val); // evaluated in double precision (FastTanh uses the same approximation)
+
+	// true if the activation's output is always within [-1, 1] (for any input that isn't NaN)
+	bool IsBounded(Type type);
+
+	// applies the activation in-place to count contiguous values
+	// uses the best SIMD kernels available on the running CPU (AVX2, SSE or NEON) and falls back to scalar code
+	// Tanh and Sigmoid are always evaluated with the standard library so that results match Apply exactly
+	void ApplyBlock(Type type, float* vals, int count);
+
+	// name of the SIMD kernels selected at runtime (for debugging)
+	const char* GetKernelName();
+}
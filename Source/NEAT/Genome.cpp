@@ -23,187 +23,402 @@
 */
 
 #include "Genome.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include "MathHelpers.h"
 #include "NEAT.h"
+#include "Random.h"
 #include "SerializeMap.h"
 
-Genome::Genome(int input_nodes, int output_nodes) : num_input_nodes{ input_nodes }, num_output_nodes{ output_nodes } {}
+Genome::Genome(int input_nodes, int output_nodes) : num_input_nodes{ input_nodes }, num_output_nodes{ output_nodes } {
+	InitTopology();
+}
 
 Genome::Genome(std::ifstream& file) {
 	file.read((char*)(&num_input_nodes), sizeof(int));
 	file.read((char*)(&num_output_nodes), sizeof(int));
 
-	NEATSerializeMap::LoadMap(forward_edges, file);
-	NEATSerializeMap::LoadMap(recurrent_edges, file);
-	NEATSerializeMap::LoadMap(disabled_forward_edges, file);
-	NEATSerializeMap::LoadMap(disabled_recurrent_edges, file);
+	std::map<std::pair<int, int>, float> edges[4]; // forward, recurrent, disabled forward, disabled recurrent
+	for (auto& e : edges) {
+		NEATSerializeMap::LoadMap(e, file);
+	}
+
+	for (int i = 0; i < 4; ++i) {
+		for (auto& e : edges[i]) {
+			genes.emplace_back(e.first.first, e.first.second, e.second, i < 2, (i % 2) == 1);
+		}
+	}
+	std::stable_sort(genes.begin(), genes.end()); // enabled genes come first among equal keys so they win below
+	genes.erase(std::unique(genes.begin(), genes.end(), [](const Gene& a, const Gene& b) { return !(a < b) && !(b < a); }), genes.end());
+
+	for (auto& e : genes) {
+		++gene_signature[GetSignatureBucket(e)];
+	}
+
+	InitTopology();
+	for (auto& e : genes) {
+		if (e.enabled && !e.recurrent) AddForwardEdgeToTopology(e.from, e.to);
+	}
 }
 
 void Genome::Save(std::ofstream& file) const {
 	file.write((const char*)(&num_input_nodes), sizeof(int));
 	file.write((const char*)(&num_output_nodes), sizeof(int));
 
-	NEATSerializeMap::SaveMap(forward_edges, file);
-	NEATSerializeMap::SaveMap(recurrent_edges, file);
-	NEATSerializeMap::SaveMap(disabled_forward_edges, file);
-	NEATSerializeMap::SaveMap(disabled_recurrent_edges, file);
-}
+	// same layout as NEATSerializeMap::SaveMap for each of the old edge maps (so saved genomes stay compatible)
+	auto saveGenes = [&](bool recurrent, bool enabled) {
+		int mapSize = 0;
+		for (auto& e : genes) {
+			if (e.recurrent == recurrent && e.enabled == enabled) ++mapSize;
+		}
+		file.write((const char*)(&mapSize), sizeof(int));
 
-void Genome::Crossover(const Genome& parent1) {
-	for (auto& e : forward_edges) {
-		auto edge_info = parent1.forward_edges.find(e.first);
-		if (edge_info != parent1.forward_edges.end()) {
-			if (NEATMathHelpers::rand_int(1) == 0) e.second = (edge_info->second);
+		for (auto& e : genes) {
+			if (e.recurrent != recurrent || e.enabled != enabled) continue;
+			file.write((const char*)(&e.from), sizeof(int));
+			file.write((const char*)(&e.to), sizeof(int));
+			file.write((const char*)(&e.weight), sizeof(float));
 		}
+	};
+	saveGenes(false, true);
+	saveGenes(true, true);
+	saveGenes(false, false);
+	saveGenes(true, false);
+}
+
+const Genome::Gene* Genome::FindGene(const std::vector<Gene>& genes, int from, int to, bool recurrent) {
+	const Gene key(from, to, 0, true, recurrent);
+	auto it = std::lower_bound(genes.begin(), genes.end(), key);
+	if (it == genes.end() || key < *it) return nullptr;
+	return &(*it);
+}
+
+void Genome::SetGene(int from, int to, bool recurrent, float weight) {
+	const Gene key(from, to, weight, true, recurrent);
+	auto it = std::lower_bound(genes.begin(), genes.end(), key);
+	if (it == genes.end() || key < *it) {
+		genes.insert(it, key);
+		++gene_signature[GetSignatureBucket(key)];
 	}
+	else *it = key;
 
-	for (auto& e : recurrent_edges) {
-		auto edge_info = parent1.recurrent_edges.find(e.first);
-		if (edge_info != parent1.recurrent_edges.end()) {
-			if (NEATMathHelpers::rand_int(1) == 0) e.second = (edge_info->second);
-		}
+	if (!recurrent) AddForwardEdgeToTopology(from, to);
+}
+
+void Genome::InitTopology() {
+	node_depths.clear();
+	for (int i = 0; i < num_input_nodes + num_output_nodes; ++i) {
+		node_depths.emplace_back(i, IsInputNode(i) ? 0 : 1);
 	}
+	max_hidden_depth = 0;
 }
 
-void Genome::GetCompatibilityDistInfo(const Genome& genome, int& nonMatching_out, int& genomeSize_out, float& avgWeightDiff_out) const {
-	int matching = 0;
-	float avgWeightDiff = 0;
+int Genome::FindNodeIndex(int id) const {
+	auto it = std::lower_bound(node_depths.begin(), node_depths.end(), id, [](const NodeDepth& a, int b) { return a.id < b; });
+	if (it == node_depths.end() || it->id != id) return -1;
+	return it - node_depths.begin();
+}
 
-	for (auto& e : forward_edges) {
-		auto edge_info = genome.forward_edges.find(e.first);
-		if (edge_info != genome.forward_edges.end()) {
-			++matching;
-			avgWeightDiff += abs(e.second - (edge_info->second));
-		}
-		else {
-			edge_info = genome.disabled_forward_edges.find(e.first);
-			if (edge_info != genome.disabled_forward_edges.end()) {
-				++matching;
-				avgWeightDiff += abs(e.second - (edge_info->second));
-			}
-		}
+Genome::NodeDepth* Genome::FindNode(int id) {
+	const int index = FindNodeIndex(id);
+	return (index < 0) ? nullptr : &node_depths[index];
+}
+
+void Genome::AddForwardEdgeToTopology(int from, int to) {
+	std::vector<int> frontier; // nodes whose depth went up (their readers might have to go up too)
+	auto raise = [&](NodeDepth* node, int depth) {
+		if (node->depth >= depth) return;
+		node->depth = depth;
+		frontier.emplace_back(node->id);
+	};
+
+	for (int id : { from, to }) {
+		if (FindNode(id) != nullptr) continue;
+		auto it = std::lower_bound(node_depths.begin(), node_depths.end(), id, [](const NodeDepth& a, int b) { return a.id < b; });
+		raise(&(*node_depths.insert(it, NodeDepth(id, 0))), 1); // new hidden node
 	}
+	raise(FindNode(to), FindNode(from)->depth + 1);
 
-	for (auto& e : disabled_forward_edges) {
-		auto edge_info = genome.forward_edges.find(e.first);
-		if (edge_info != genome.forward_edges.end()) {
-			++matching;
-			avgWeightDiff += abs(e.second - (edge_info->second));
-		}
-		else {
-			edge_info = genome.disabled_forward_edges.find(e.first);
-			if (edge_info != genome.disabled_forward_edges.end()) {
-				++matching;
-				avgWeightDiff += abs(e.second - (edge_info->second));
+	while (!frontier.empty()) {
+		const int curNode = frontier.back();
+		frontier.pop_back();
+		const int depth = FindNode(curNode)->depth;
+
+		if (!IsOutputNode(curNode) && depth > max_hidden_depth) {
+			max_hidden_depth = depth;
+			for (int i = num_input_nodes; i < num_input_nodes + num_output_nodes; ++i) {
+				raise(FindNode(i), depth + 1);
 			}
 		}
+
+		// forward genes are sorted by from, so the readers of curNode are contiguous
+		// (readers that aren't in node_depths yet only happen while loading, and get their depth once their own gene is added)
+		for (auto it = std::lower_bound(genes.begin(), genes.end(), Gene(curNode, 0, 0, true, false)); it != genes.end() && !it->recurrent && it->from == curNode; ++it) {
+			if (!it->enabled) continue;
+			NodeDepth* reader = FindNode(it->to);
+			if (reader != nullptr) raise(reader, depth + 1);
+		}
 	}
+}
 
-	for (auto& e : recurrent_edges) {
-		auto edge_info = genome.recurrent_edges.find(e.first);
-		if (edge_info != genome.recurrent_edges.end()) {
-			++matching;
-			avgWeightDiff += abs(e.second - (edge_info->second));
+bool Genome::CheckRecurrent(const std::vector<NodeDepth>& sorted_nodes, int from_index, int to_index) const {
+	const int from = sorted_nodes[from_index].id;
+	const int to = sorted_nodes[to_index].id;
+	if (from == to) return true;
+	if (IsOutputNode(from) && !IsOutputNode(to)) return true;
+
+	// start at to and see if we can find from by following enabled forward genes (one DFS, so O(nodes + genes) per check)
+	// a single query doesn't pay for building a ReachabilityIndex (Genome::Network keeps one since it answers many queries)
+	// (the buffers are kept around so checks don't allocate once they're big enough)
+	static thread_local std::vector<char> discovered; // indexed like node_depths
+	static thread_local std::vector<int> frontier;
+	discovered.assign(node_depths.size(), 0);
+	frontier.clear();
+	frontier.emplace_back(to);
+	discovered[FindNodeIndex(to)] = 1;
+	while (frontier.size() > 0) {
+		const int curNode = frontier.back();
+		frontier.pop_back();
+
+		if (curNode == from) return true;
+
+		// forward genes are sorted by from, so the readers of curNode are contiguous
+		for (auto it = std::lower_bound(genes.begin(), genes.end(), Gene(curNode, 0, 0, true, false)); it != genes.end() && !it->recurrent && it->from == curNode; ++it) {
+			if (!it->enabled) continue;
+			const int readerIndex = FindNodeIndex(it->to);
+			if (readerIndex < 0 || discovered[readerIndex]) continue;
+			discovered[readerIndex] = 1;
+			frontier.emplace_back(it->to);
 		}
-		else {
-			edge_info = genome.disabled_recurrent_edges.find(e.first);
-			if (edge_info != genome.disabled_recurrent_edges.end()) {
-				++matching;
-				avgWeightDiff += abs(e.second - (edge_info->second));
-			}
+	}
+
+	return false;
+}
+
+int Genome::GetSignatureBucket(const Gene& gene) {
+	unsigned int hash = ((unsigned int)gene.from * 0x9E3779B1u) ^ ((unsigned int)gene.to * 0x85EBCA77u);
+	if (gene.recurrent) hash ^= 0xC2B2AE3Du;
+	hash ^= hash >> 15;
+	hash *= 0x2C1B3C6Du;
+	return hash >> 26; // top 6 bits (NUM_SIGNATURE_BUCKETS == 64)
+}
+
+// both gene vectors are sorted the same way, so matching genes are found by walking them together
+void Genome::Crossover(const Genome& parent1) {
+	auto other = parent1.genes.begin();
+	for (auto& e : genes) {
+		while (other != parent1.genes.end() && *other < e) ++other;
+		if (other == parent1.genes.end()) break;
+		if (e < *other) continue;
+
+		if (e.enabled && other->enabled) {
+			if (NEATMathHelpers::rand_int(1) == 0) e.weight = other->weight;
 		}
 	}
+}
+
+// lower bound of the compatibility distance when at most maxMatching genes match and the weight differences add up to at least weightDiffSum
+// (the distance only decreases with more matching genes, and the average weight difference can't get below weightDiffSum / maxMatching)
+static float GetCompatibilityLowerBound(int totalGenes, int maxMatching, float weightDiffSum, float c1_c2, float c3) {
+	const int genomeSize = totalGenes - maxMatching;
+	if (genomeSize <= 0) return 0;
+	const double structural = ((double)c1_c2 * (totalGenes - 2 * maxMatching)) / genomeSize;
+	const double weights = (maxMatching <= 0) ? 0 : ((double)c3 * weightDiffSum / maxMatching);
+	return structural + weights;
+}
+
+bool Genome::GetMatchingInfo(const Genome& genome, float c1_c2, float c3, float max_dist, int& matching_out, float& weightDiffSum_out, float& lowerBound_out) const {
+	const int totalGenes = genes.size() + genome.genes.size();
+	const bool useBounds = c1_c2 >= 0 && c3 >= 0 && max_dist < std::numeric_limits<float>::infinity();
+	const float cutoff = max_dist + 1e-3f * (1 + std::fabs(max_dist)); // leaves room for rounding so early exits never change the outcome
 
-	for (auto& e : disabled_recurrent_edges) {
-		auto edge_info = genome.recurrent_edges.find(e.first);
-		if (edge_info != genome.recurrent_edges.end()) {
-			++matching;
-			avgWeightDiff += abs(e.second - (edge_info->second));
+	// cheap checks first: genome sizes and then the gene signatures
+	int maxMatching = std::min(genes.size(), genome.genes.size());
+	if (useBounds) {
+		lowerBound_out = GetCompatibilityLowerBound(totalGenes, maxMatching, 0, c1_c2, c3);
+		if (lowerBound_out >= cutoff) return false;
+
+		int signatureMatching = 0;
+		for (int i = 0; i < NUM_SIGNATURE_BUCKETS; ++i) {
+			signatureMatching += std::min(gene_signature[i], genome.gene_signature[i]);
 		}
-		else {
-			edge_info = genome.disabled_recurrent_edges.find(e.first);
-			if (edge_info != genome.disabled_recurrent_edges.end()) {
+		maxMatching = std::min(maxMatching, signatureMatching);
+		lowerBound_out = GetCompatibilityLowerBound(totalGenes, maxMatching, 0, c1_c2, c3);
+		if (lowerBound_out >= cutoff) return false;
+	}
+
+	int matching = 0;
+	float avgWeightDiff = 0;
+
+	// enabled genes are summed before disabled ones (within forward and then recurrent genes)
+	auto recurrentBegin = [](const std::vector<Gene>& g) { return std::partition_point(g.begin(), g.end(), [](const Gene& e) { return !e.recurrent; }); };
+	const std::vector<Gene>::const_iterator ranges[2][2] = {
+		{ genes.begin(), recurrentBegin(genes) },
+		{ recurrentBegin(genes), genes.end() }
+	};
+	const std::vector<Gene>::const_iterator otherRanges[2][2] = {
+		{ genome.genes.begin(), recurrentBegin(genome.genes) },
+		{ recurrentBegin(genome.genes), genome.genes.end() }
+	};
+
+	for (int r = 0; r < 2; ++r) {
+		int disabledMatches = 0; // matches of disabled genes get summed in a second pass (only needed if there are any)
+		for (int pass = 0; pass < 2; ++pass) {
+			if (pass == 1 && disabledMatches == 0) break;
+			auto other = otherRanges[r][0];
+			int steps = 0;
+			for (auto it = ranges[r][0]; it != ranges[r][1]; ++it) {
+				// every so often check whether the genes left can still bring the distance under max_dist
+				if (useBounds && pass == 0 && (++steps & 31) == 0) {
+					const int genesLeft = genes.end() - it;
+					lowerBound_out = GetCompatibilityLowerBound(totalGenes, std::min(maxMatching, matching + disabledMatches + genesLeft), avgWeightDiff, c1_c2, c3);
+					if (lowerBound_out >= cutoff) return false;
+				}
+
+				const unsigned long long key = it->GetKey();
+				while (other != otherRanges[r][1] && other->GetKey() < key) ++other;
+				if (other == otherRanges[r][1]) break;
+				if (other->GetKey() != key) continue;
+				if (it->enabled != (pass == 0)) {
+					if (pass == 0) ++disabledMatches;
+					continue;
+				}
+
 				++matching;
-				avgWeightDiff += abs(e.second - (edge_info->second));
+				avgWeightDiff += abs(it->weight - other->weight);
 			}
 		}
 	}
 
-	const int nonMatching = forward_edges.size() + disabled_forward_edges.size() + genome.forward_edges.size() + genome.disabled_forward_edges.size() +
-		recurrent_edges.size() + disabled_recurrent_edges.size() + genome.recurrent_edges.size() + genome.disabled_recurrent_edges.size() - 2 * matching;
+	matching_out = matching;
+	weightDiffSum_out = avgWeightDiff;
+	return true;
+}
+
+void Genome::GetCompatibilityDistInfo(const Genome& genome, int& nonMatching_out, int& genomeSize_out, float& avgWeightDiff_out) const {
+	int matching;
+	float avgWeightDiff;
+	float lowerBound;
+	GetMatchingInfo(genome, 0, 0, std::numeric_limits<float>::infinity(), matching, avgWeightDiff, lowerBound);
+
+	const int nonMatching = genes.size() + genome.genes.size() - 2 * matching;
 	nonMatching_out = nonMatching;
 	genomeSize_out = nonMatching + matching;
 	avgWeightDiff_out = (matching == 0) ? 0 : (avgWeightDiff / matching);
 }
 
+float Genome::GetCompatibilityDist(const Genome& genome, float c1_c2, float c3, float max_dist) const {
+	int matching;
+	float avgWeightDiff;
+	float lowerBound;
+	if (!GetMatchingInfo(genome, c1_c2, c3, max_dist, matching, avgWeightDiff, lowerBound)) return lowerBound;
+
+	const int nonMatching = genes.size() + genome.genes.size() - 2 * matching;
+	const int genomeSize = nonMatching + matching;
+	avgWeightDiff = (matching == 0) ? 0 : (avgWeightDiff / matching);
+	return (genomeSize <= 0) ? 0 : ((c1_c2 * nonMatching) / genomeSize + c3 * avgWeightDiff);
+}
+
 void Genome::MutateWeights(float perturbStdDev, float randomValStdDev, float randomValProb) {
-	for (auto& e : forward_edges) {
-		if (NEATMathHelpers::rand_norm() < randomValProb) e.second = NEATMathHelpers::randomGaussian(randomValStdDev);
-		else e.second += NEATMathHelpers::randomGaussian(perturbStdDev);
+	NEATRandom::Engine& rng = NEATRandom::GetEngine(); // (looked up once instead of for every gene)
+	for (auto& e : genes) {
+		if (!e.enabled) continue;
+		if (rng.Uniform() < randomValProb) e.weight = randomValStdDev * rng.Gaussian();
+		else e.weight += perturbStdDev * rng.Gaussian();
 	}
+}
 
-	for (auto& e : recurrent_edges) {
-		if (NEATMathHelpers::rand_norm() < randomValProb) e.second = NEATMathHelpers::randomGaussian(randomValStdDev);
-		else e.second += NEATMathHelpers::randomGaussian(perturbStdDev);
+void Genome::MarkInnovations(InnovationRegistry& registry) const {
+	for (auto& e : genes) {
+		registry.Mark(e.from, e.to, e.recurrent);
 	}
 }
 
+static unsigned long long MixFingerprint(unsigned long long hash, unsigned long long val) {
+	hash ^= val + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+int Genome::GetNumGenes() const {
+	return genes.size();
+}
+
+unsigned long long Genome::GetFingerprint() const {
+	unsigned long long hash = MixFingerprint(num_input_nodes, num_output_nodes);
+	for (auto& e : genes) {
+		if (!e.enabled) continue; // (disabled genes don't end up in the network)
+		unsigned int weightBits;
+		memcpy(&weightBits, &e.weight, sizeof(float));
+		hash = MixFingerprint(hash, e.GetKey());
+		hash = MixFingerprint(hash, weightBits);
+	}
+	return hash;
+}
+
+bool Genome::IsInputNode(int node_id) const {
+	return node_id < num_input_nodes;
+}
+
 bool Genome::IsOutputNode(int node_id) const {
 	return !((node_id < num_input_nodes) || (node_id >= (num_input_nodes + num_output_nodes)));
 }
 
-Genome::Network Genome::GenerateNetwork() const {
-	return Network(num_input_nodes, num_output_nodes, forward_edges, recurrent_edges);
+Genome::Network Genome::GenerateNetwork(const OptimizeSettings* optimize) const {
+	return Network(num_input_nodes, num_output_nodes, genes, optimize);
 }
 
-bool Genome::AddNodeMutation(NEAT& n) {
-	std::vector<std::pair<int, int>> possibleEdges;
+NetworkBase Genome::GenerateNetworkBase(const OptimizeSettings* optimize, OptimizeReport* report_out) const {
+	const Network network(num_input_nodes, num_output_nodes, genes, optimize, true);
+	if (report_out != nullptr) *report_out = network.GetOptimizeReport();
+	return network;
+}
 
-	for (auto& e : forward_edges) {
-		auto fromNode = std::get<0>(e.first);
-		if (IsOutputNode(fromNode)) continue;
+bool Genome::AddNodeMutation(NEAT& n) {
+	int from;
+	int to;
+	bool recurrent;
+	if (!PickNodeMutation(from, to, recurrent)) return false;
 
-		possibleEdges.emplace_back(e.first);
-	}
+	ApplyNodeMutation(from, to, recurrent, n.GetAddNodeNumber({ from, to }, recurrent));
+	return true;
+}
 
-	const int numNormalEdges = possibleEdges.size();
+bool Genome::PickNodeMutation(int& from_out, int& to_out, bool& recurrent_out) const {
+	std::vector<int> possibleEdges; // indices into genes (forward genes come first)
 
-	for (auto& e : recurrent_edges) {
-		auto fromNode = std::get<0>(e.first);
-		if (IsOutputNode(fromNode)) continue;
+	for (int i = 0; i < (int)genes.size(); ++i) {
+		if (!genes[i].enabled) continue;
+		if (IsOutputNode(genes[i].from)) continue;
 
-		possibleEdges.emplace_back(e.first);
+		possibleEdges.emplace_back(i);
 	}
 
 	if (possibleEdges.size() < 1) return false; // no possible edges to split
 
 	const int randIndex = NEATMathHelpers::rand_int(possibleEdges.size() - 1);
-	const bool isRecurrent = randIndex >= numNormalEdges;
-	const int oldFromNode = std::get<0>(possibleEdges[randIndex]);
-	const int oldToNode = std::get<1>(possibleEdges[randIndex]);
-	const int newNode = n.GetAddNodeNumber(possibleEdges[randIndex], isRecurrent);
-
-	float oldWeight;
-	if (isRecurrent) {
-		oldWeight = recurrent_edges[possibleEdges[randIndex]];
-		recurrent_edges.erase(possibleEdges[randIndex]);
-		disabled_recurrent_edges[possibleEdges[randIndex]] = oldWeight;
-	}
-	else {
-		oldWeight = forward_edges[possibleEdges[randIndex]];
-		forward_edges.erase(possibleEdges[randIndex]);
-		disabled_forward_edges[possibleEdges[randIndex]] = oldWeight;
-	}
+	const Gene& oldGene = genes[possibleEdges[randIndex]];
+	from_out = oldGene.from;
+	to_out = oldGene.to;
+	recurrent_out = oldGene.recurrent;
+	return true;
+}
 
-	forward_edges[{oldFromNode, newNode}] = 1;
-	if (isRecurrent) {
-		recurrent_edges[{newNode, oldToNode}] = oldWeight;
-	}
-	else {
-		forward_edges[{newNode, oldToNode}] = oldWeight;
+void Genome::ApplyNodeMutation(int from, int to, bool recurrent, int new_node) {
+	const Gene* oldGene = FindGene(genes, from, to, recurrent);
+	if (oldGene == nullptr) {
+		std::cerr << "ApplyNodeMutation failed since the edge isn't part of the genome" << std::endl;
+		return;
 	}
+	const float oldWeight = oldGene->weight;
+	genes[oldGene - genes.data()].enabled = false; // (SetGene below can invalidate oldGene)
 
-	return true;
+	SetGene(from, new_node, false, 1);
+	SetGene(new_node, to, recurrent, oldWeight);
 }
 
 // should be used on empty genome
@@ -211,10 +426,92 @@ void Genome::AddInputOutputEdge(float randomValStdDev) {
 	int in = NEATMathHelpers::rand_int(num_input_nodes - 1); // any input node (or bias)
 	int out = NEATMathHelpers::rand_int(num_input_nodes, num_input_nodes + num_output_nodes - 1); // any output node
 
-	forward_edges[{in, out}] = NEATMathHelpers::randomGaussian(randomValStdDev);
+	SetGene(in, out, false, NEATMathHelpers::randomGaussian(randomValStdDev));
+}
+
+bool Genome::HasEnabledEdge(int from, int to) const {
+	const Gene* forwardGene = FindGene(genes, from, to, false);
+	if (forwardGene != nullptr && forwardGene->enabled) return true;
+	const Gene* recurrentGene = FindGene(genes, from, to, true);
+	return recurrentGene != nullptr && recurrentGene->enabled;
+}
+
+// same candidates as the random tries in AddEdgeMutation (any node to any node that isn't an input)
+bool Genome::PickAbsentEdge(const std::vector<NodeDepth>& sorted_nodes, int& from_index_out, int& to_index_out) const {
+	const int numTargets = sorted_nodes.size() - num_input_nodes;
+
+	// enabled edges out of each node (indexed like node_depths)
+	std::vector<int> numEdges(node_depths.size(), 0);
+	for (auto& e : genes) {
+		if (!e.enabled || IsInputNode(e.to)) continue;
+		if (e.recurrent) {
+			const Gene* forwardGene = FindGene(genes, e.from, e.to, false);
+			if (forwardGene != nullptr && forwardGene->enabled) continue; // (already counted)
+		}
+		const int fromIndex = FindNodeIndex(e.from);
+		if (fromIndex >= 0 && FindNodeIndex(e.to) >= 0) ++numEdges[fromIndex];
+	}
+
+	int numAbsent = 0;
+	for (auto& node : sorted_nodes) {
+		numAbsent += numTargets - numEdges[FindNodeIndex(node.id)];
+	}
+	if (numAbsent <= 0) return false; // every edge exists
+
+	// find the node the edge starts from, and then which of its absent edges it is
+	int pick = NEATMathHelpers::rand_int(numAbsent - 1);
+	for (int i = 0; i < (int)sorted_nodes.size(); ++i) {
+		const int nodeAbsent = numTargets - numEdges[FindNodeIndex(sorted_nodes[i].id)];
+		if (pick >= nodeAbsent) {
+			pick -= nodeAbsent;
+			continue;
+		}
+
+		for (int j = num_input_nodes; j < (int)sorted_nodes.size(); ++j) {
+			if (HasEnabledEdge(sorted_nodes[i].id, sorted_nodes[j].id)) continue;
+			if (pick-- > 0) continue;
+			from_index_out = i;
+			to_index_out = j;
+			return true;
+		}
+	}
+
+	std::cerr << "PickAbsentEdge could not find the edge it picked" << std::endl;
+	return false;
 }
 
 // this could enable a disabled connection
+// picks nodes the same way as Genome::Network::FindNewPossibleConnection (by their index in the network)
+bool Genome::AddEdgeMutation(float randomValStdDev, int max_tries) {
+	std::vector<NodeDepth> sortedNodes = node_depths;
+	std::sort(sortedNodes.begin(), sortedNodes.end(), [](const NodeDepth& a, const NodeDepth& b) {
+		if (a.depth == b.depth) return a.id < b.id;
+		return a.depth < b.depth;
+	});
+
+	int inIndex = -1;
+	int outIndex = -1;
+	for (int try_num = 0; try_num < max_tries; ++try_num) {
+		const int randIn = NEATMathHelpers::rand_int(sortedNodes.size() - 1); // can be any node
+		const int randOut = NEATMathHelpers::rand_int(num_input_nodes, sortedNodes.size() - 1); // any node that isn't an input (or bias)
+
+		// check if connection already exists (check normal and recurrent connections)
+		if (HasEnabledEdge(sortedNodes[randIn].id, sortedNodes[randOut].id)) continue;
+
+		inIndex = randIn;
+		outIndex = randOut;
+		break;
+	}
+
+	// every try hit an existing edge (likely in dense genomes), so draw from the absent edges directly
+	// (a try that succeeds is also uniform over the absent edges, so this doesn't change which edges get picked)
+	if (inIndex < 0 && !PickAbsentEdge(sortedNodes, inIndex, outIndex)) return false;
+
+	const bool is_recurrent = CheckRecurrent(sortedNodes, inIndex, outIndex);
+	SetGene(sortedNodes[inIndex].id, sortedNodes[outIndex].id, is_recurrent, NEATMathHelpers::randomGaussian(randomValStdDev));
+	return true;
+}
+
 bool Genome::AddEdgeMutation(const Network& network, float randomValStdDev, int max_tries) {
 	int in;
 	int out;
@@ -222,14 +519,7 @@ bool Genome::AddEdgeMutation(const Network& network, float randomValStdDev, int
 
 	if (!network.FindNewPossibleConnection(in, out, is_recurrent, max_tries)) return false;
 
-	if (is_recurrent) {
-		recurrent_edges[{in, out}] = NEATMathHelpers::randomGaussian(randomValStdDev);
-		disabled_recurrent_edges.erase({ in,out });
-	}
-	else {
-		forward_edges[{in, out}] = NEATMathHelpers::randomGaussian(randomValStdDev);
-		disabled_forward_edges.erase({ in,out });
-	}
+	SetGene(in, out, is_recurrent, NEATMathHelpers::randomGaussian(randomValStdDev));
 
 	return true;
 }
\ No newline at end of file
@@ -24,40 +24,83 @@
 
 #pragma once
 
+#include <array>
 #include <map>
+#include <vector>
 #include <unordered_set>
 #include "Network.h"
+#include "InnovationRegistry.h"
+#include "ReachabilityIndex.h"
 
 class NEAT;
 
 class Genome {
+public:
+	// optional pass that simplifies the genome's graph before it gets flattened into a network (see Genome::Network)
+	// optimized networks give the same outputs (up to rounding), but they shouldn't be passed to AddEdgeMutation
+	// since the structure they leave out is still part of the genome
+	struct OptimizeSettings {
+		bool remove_dead_nodes = true; // hidden nodes that no output depends on (directly or through recurrent connections)
+		float prune_weight = 0; // edges with abs(weight) <= prune_weight are dropped (only exact zeros by default; negative disables)
+		bool fold_constants = true; // hidden nodes that only depend on the bias get evaluated once and merged into the bias weights of their readers
+	};
+
+	struct OptimizeReport {
+		int removed_nodes = 0;
+		int removed_edges = 0;
+		int folded_nodes = 0; // constant nodes (included in removed_nodes)
+		void operator+=(const OptimizeReport& other);
+	};
+
 private:
+	// an edge of the genome; genes are kept in one vector sorted by (recurrent, from, to)
+	// so copying a genome is a single allocation and comparing two genomes is a merge join
+	struct Gene {
+		int from = 0;
+		int to = 0;
+		float weight = 0;
+		bool enabled = true; // disabled genes are kept around for the compatibility distance
+		bool recurrent = false;
+		Gene(int argFrom, int argTo, float argWeight, bool argEnabled, bool argRecurrent) : from{ argFrom }, to{ argTo }, weight{ argWeight }, enabled{ argEnabled }, recurrent{ argRecurrent } {}
+		unsigned long long GetKey() const { return ((unsigned long long)recurrent << 62) | ((unsigned long long)from << 31) | (unsigned long long)to; } // (node ids are non-negative)
+		bool operator<(const Gene& other) const { return GetKey() < other.GetKey(); } // forward genes first
+	};
+
 	class Network : public NetworkBaseVisual {
 	public:
-		Network(int input_nodes, int output_nodes, const std::map<std::pair<int, int>, float>& forward_edges, const std::map<std::pair<int, int>, float>& recurrent_edges);
+		// lean networks leave out the visualization information and the edges used by FindNewPossibleConnection (see Genome::GenerateNetworkBase)
+		Network(int input_nodes, int output_nodes, const std::vector<Gene>& genes, const OptimizeSettings* optimize = nullptr, bool lean = false);
+
+		const OptimizeReport& GetOptimizeReport() const; // for debugging (all zeros if the network wasn't optimized)
 
 		void PrintForwardEdges() const; // for debugging
 
+		// tries max_tries random node pairs and then draws uniformly from every absent edge (fails only once every edge exists)
 		bool FindNewPossibleConnection(int& in, int& out, bool& is_recurrent, int max_tries) const; // used by Genome::AddEdgeMutation
 
 	protected:
 		virtual void LoadImpl(std::ifstream& file) override;
+		virtual bool LoadMappedImpl(const std::shared_ptr<const NEATNetworkFile::MappedFile>& mapping) override;
 
 	private:
-		std::map<int, std::unordered_set<int>> adjacency_list; // used in FindNewPossibleConnection
-		std::map<int, std::unordered_set<int>> adjacency_list_recurrent_rev; // used in FindNewPossibleConnection
-
-		bool CheckRecurrent(int inputLabel, int outputLabel) const; // helper for FindNewPossibleConnection
-
-		struct NeuronIdDepth {
-			int id = 0;
-			int depth = 0;
-			NeuronIdDepth(int argID, int argDepth) : id{ argID }, depth{ argDepth } {}
-			bool operator<(const NeuronIdDepth& other) const {
-				if (depth == other.depth) return id < other.id; // same depth; so compare ID
-				return depth < other.depth;
-			}
-		};
+		OptimizeReport optimize_report;
+
+		void Build(int input_nodes, int output_nodes, const std::vector<Gene>& genes, bool lean); // helper for ctor
+		OptimizeReport Optimize(const OptimizeSettings& settings, std::vector<Gene>& genes) const; // helper for ctor
+
+		// edges into each node for FindNewPossibleConnection (the sources of node i are edge_sources[edge_starts[i] .. edge_starts[i + 1]))
+		// sources are (internal index << 1) | is_recurrent, sorted
+		std::vector<int> edge_starts;
+		std::vector<int> edge_sources;
+
+		bool CheckRecurrent(int inputIndex, int outputIndex) const; // helper for FindNewPossibleConnection (takes internal indices)
+		bool HasEdge(int inputIndex, int outputIndex) const; // forward or recurrent (takes internal indices)
+		bool PickAbsentEdge(int& inputIndex_out, int& outputIndex_out) const; // uniformly picks an edge that doesn't exist yet (false if there's none)
+
+		// built on the first call to CheckRecurrent (node indices are the internal ones, which are in topological order)
+		mutable ReachabilityIndex reachability;
+		mutable bool reachability_built = false;
+		void BuildReachability() const;
 	};
 
 public:
@@ -65,26 +108,74 @@ public:
 	Genome(std::ifstream& file);
 	void Save(std::ofstream& file) const;
 
-	Network GenerateNetwork() const;
-
-	bool AddNodeMutation(NEAT& n);
-	bool AddEdgeMutation(const Network& network, float randomValStdDev, int max_tries = 3);
+	Network GenerateNetwork(const OptimizeSettings* optimize = nullptr) const;
+	// same network without the visualization information (cheaper to build and to keep around if the network only gets run)
+	NetworkBase GenerateNetworkBase(const OptimizeSettings* optimize = nullptr, OptimizeReport* report_out = nullptr) const;
+
+	bool AddNodeMutation(NEAT& n); // not thread-safe since the new node gets numbered right away (see NEAT::GetAddNodeNumber)
+	// AddNodeMutation split in two so the node can be numbered later (used by NEAT::UpdateGeneration)
+	bool PickNodeMutation(int& from_out, int& to_out, bool& recurrent_out) const; // picks the edge to split (returns false if there's none)
+	void ApplyNodeMutation(int from, int to, bool recurrent, int new_node);
+	// tries max_tries random node pairs and then draws uniformly from every absent edge, so it only fails once every edge exists
+	bool AddEdgeMutation(float randomValStdDev, int max_tries = 3); // uses the cached topology (doesn't generate a network)
+	bool AddEdgeMutation(const Network& network, float randomValStdDev, int max_tries = 3); // same as above given the network of this genome
 	void AddInputOutputEdge(float randomValStdDev);
 
 	void Crossover(const Genome& parent1);
 
 	void GetCompatibilityDistInfo(const Genome& genome, int& nonMatching_out, int& genomeSize_out, float& avgWeightDiff_out) const;
+	// returns the compatibility distance, or stops early and returns some value >= max_dist once the distance can't be under max_dist
+	// (the early exits only kick in when c1_c2 and c3 are non-negative)
+	float GetCompatibilityDist(const Genome& genome, float c1_c2, float c3, float max_dist) const;
 
 	void MutateWeights(float perturbStdDev, float randomValStdDev, float randomValProb);
 
+	void MarkInnovations(InnovationRegistry& registry) const; // used by NEAT to prune its registry (see InnovationRegistry::Mark)
+
+	// 64-bit hash of everything the network depends on (the input and output sizes and the enabled genes with their weights)
+	// genomes with the same fingerprint compile into the same network (NEAT uses it to reuse networks and fitnesses)
+	unsigned long long GetFingerprint() const;
+
+	int GetNumGenes() const; // for debugging (including disabled genes)
+
 private:
 	int num_input_nodes;
 	int num_output_nodes;
-	std::map<std::pair<int, int>, float> forward_edges;
-	std::map<std::pair<int, int>, float> recurrent_edges;
-
-	std::map<std::pair<int, int>, float> disabled_forward_edges;
-	std::map<std::pair<int, int>, float> disabled_recurrent_edges;
-
+	std::vector<Gene> genes; // sorted (see Gene::operator<) and unique by (recurrent, from, to)
+
+	// number of genes per hash bucket of their key; sum of the bucket wise minimums of two genomes
+	// is an upper bound on their matching genes (used to skip distant genomes in GetCompatibilityDist)
+	static constexpr int NUM_SIGNATURE_BUCKETS = 64;
+	std::array<unsigned short, NUM_SIGNATURE_BUCKETS> gene_signature{}; // (would only overflow with millions of genes)
+	static int GetSignatureBucket(const Gene& gene);
+
+	// merge join of the genes (early exit once the distance can't be under max_dist; returns false in that case)
+	bool GetMatchingInfo(const Genome& genome, float c1_c2, float c3, float max_dist, int& matching_out, float& weightDiffSum_out, float& lowerBound_out) const;
+
+	// cached topology of the network this genome compiles into (updated whenever a forward gene gets enabled)
+	// nodes are the inputs, the outputs and the ends of enabled forward genes, and depths are the ones Genome::Network gives them:
+	// inputs are 0, hidden nodes are 1 + their deepest forward input, and outputs also come after every hidden node
+	// (adding a node or an edge can only raise depths, so they're kept up to date by pushing the raises forward)
+	struct NodeDepth {
+		int id = 0;
+		int depth = 0;
+		NodeDepth(int argID, int argDepth) : id{ argID }, depth{ argDepth } {}
+	};
+	std::vector<NodeDepth> node_depths; // sorted by id
+	int max_hidden_depth = 0;
+	void InitTopology(); // inputs and outputs only
+	int FindNodeIndex(int id) const; // index into node_depths (-1 if not found)
+	NodeDepth* FindNode(int id); // nullptr if not found
+	void AddForwardEdgeToTopology(int from, int to); // call after the gene is enabled
+	// whether the edge between the nodes would close a cycle (same as Genome::Network::CheckRecurrent)
+	// sorted_nodes is node_depths sorted by (depth, id), which is the topological order of the network
+	bool CheckRecurrent(const std::vector<NodeDepth>& sorted_nodes, int from_index, int to_index) const;
+	// uniformly picks an edge that isn't enabled yet (returns false if there's none); O(nodes + genes) with binary searches
+	bool PickAbsentEdge(const std::vector<NodeDepth>& sorted_nodes, int& from_index_out, int& to_index_out) const;
+	bool HasEnabledEdge(int from, int to) const; // forward or recurrent
+
+	bool IsInputNode(int node_id) const;
 	bool IsOutputNode(int node_id) const;
+	static const Gene* FindGene(const std::vector<Gene>& genes, int from, int to, bool recurrent); // nullptr if not found
+	void SetGene(int from, int to, bool recurrent, float weight); // adds the gene or overwrites (and enables) an existing one
 };
\ No newline at end of file
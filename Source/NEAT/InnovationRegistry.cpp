@@ -0,0 +1,174 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "InnovationRegistry.h"
+#include <algorithm>
+
+unsigned long long InnovationRegistry::GetKey(int from, int to, bool recurrent) {
+	return ((unsigned long long)recurrent << 62) | ((unsigned long long)from << 31) | (unsigned long long)to;
+}
+
+size_t InnovationRegistry::FindSlot(unsigned long long key) const {
+	const size_t mask = entries.size() - 1;
+	size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+	while (entries[slot].key != key && entries[slot].key != EMPTY_KEY) {
+		slot = (slot + 1) & mask; // linear probing
+	}
+	return slot;
+}
+
+void InnovationRegistry::Rehash(size_t capacity) {
+	std::vector<Entry> oldEntries;
+	oldEntries.swap(entries);
+	entries.assign(capacity, Entry());
+	for (auto& e : oldEntries) {
+		if (e.key != EMPTY_KEY) entries[FindSlot(e.key)] = e;
+	}
+}
+
+int InnovationRegistry::Find(int from, int to, bool recurrent) const {
+	if (entries.empty()) return -1;
+	const Entry& e = entries[FindSlot(GetKey(from, to, recurrent))];
+	return (e.key == EMPTY_KEY) ? -1 : e.node;
+}
+
+void InnovationRegistry::Insert(int from, int to, bool recurrent, int node) {
+	if ((size_t)(size + 1) * 2 > entries.size()) Rehash(std::max((size_t)MIN_CAPACITY, entries.size() * 2));
+
+	const unsigned long long key = GetKey(from, to, recurrent);
+	Entry& e = entries[FindSlot(key)];
+	if (e.key == EMPTY_KEY) ++size;
+	e.key = key;
+	e.node = node;
+	e.marked = true; // (so entries added during a generation survive the next Sweep)
+}
+
+void InnovationRegistry::Clear() {
+	entries.clear();
+	size = 0;
+}
+
+int InnovationRegistry::GetSize() const {
+	return size;
+}
+
+size_t InnovationRegistry::GetNumBytes() const {
+	return entries.size() * sizeof(Entry);
+}
+
+void InnovationRegistry::Mark(int from, int to, bool recurrent) {
+	if (entries.empty()) return;
+	Entry& e = entries[FindSlot(GetKey(from, to, recurrent))];
+	if (e.key != EMPTY_KEY) e.marked = true;
+}
+
+int InnovationRegistry::Sweep() {
+	int dropped = 0;
+	for (auto& e : entries) {
+		if (e.key == EMPTY_KEY) continue;
+		if (!e.marked) {
+			e.key = EMPTY_KEY;
+			++dropped;
+		}
+		e.marked = false;
+	}
+	size -= dropped;
+
+	// rebuild since linear probing can't just leave holes (also shrinks the table)
+	size_t capacity = MIN_CAPACITY;
+	while (capacity < (size_t)size * 2) capacity *= 2;
+	if (dropped > 0 || capacity < entries.size()) Rehash(capacity);
+	return dropped;
+}
+
+void InnovationRegistry::BeginProposals(int num_slots) {
+	proposals.assign(num_slots, Proposal());
+}
+
+void InnovationRegistry::Propose(int slot, int from, int to, bool recurrent) {
+	Proposal& p = proposals[slot];
+	p.from = from;
+	p.to = to;
+	p.recurrent = recurrent;
+	p.node = -1;
+}
+
+void InnovationRegistry::ResolveProposals(int& node_ctr) {
+	for (auto& p : proposals) {
+		if (p.from < 0) continue;
+
+		p.node = Find(p.from, p.to, p.recurrent);
+		if (p.node >= 0) continue;
+
+		p.node = ++node_ctr;
+		Insert(p.from, p.to, p.recurrent, p.node);
+	}
+}
+
+int InnovationRegistry::GetProposedNode(int slot) const {
+	return proposals[slot].node;
+}
+
+void InnovationRegistry::Load(std::ifstream& file) {
+	Clear();
+	for (int recurrent = 0; recurrent < 2; ++recurrent) {
+		int mapSize;
+		file.read((char*)(&mapSize), sizeof(int));
+
+		int fromNode;
+		int toNode;
+		int node;
+		for (int i = 0; i < mapSize; ++i) {
+			file.read((char*)(&fromNode), sizeof(int));
+			file.read((char*)(&toNode), sizeof(int));
+			file.read((char*)(&node), sizeof(int));
+			Insert(fromNode, toNode, recurrent == 1, node);
+		}
+	}
+}
+
+void InnovationRegistry::Save(std::ofstream& file) const {
+	std::vector<const Entry*> sorted;
+	sorted.reserve(size);
+	for (auto& e : entries) {
+		if (e.key != EMPTY_KEY) sorted.emplace_back(&e);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->key < b->key; });
+	const int numForward = std::partition_point(sorted.begin(), sorted.end(), [](const Entry* e) { return (e->key >> 62) == 0; }) - sorted.begin();
+
+	for (int recurrent = 0; recurrent < 2; ++recurrent) {
+		const int begin = recurrent ? numForward : 0;
+		const int end = recurrent ? (int)sorted.size() : numForward;
+		const int mapSize = end - begin;
+		file.write((const char*)(&mapSize), sizeof(int));
+
+		for (int i = begin; i < end; ++i) {
+			const int fromNode = (int)((sorted[i]->key >> 31) & 0x7FFFFFFF);
+			const int toNode = (int)(sorted[i]->key & 0x7FFFFFFF);
+			file.write((const char*)(&fromNode), sizeof(int));
+			file.write((const char*)(&toNode), sizeof(int));
+			file.write((const char*)(&sorted[i]->node), sizeof(int));
+		}
+	}
+}
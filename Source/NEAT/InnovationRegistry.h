@@ -0,0 +1,85 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <fstream>
+
+// remembers which node was inserted when an edge got split by Genome::AddNodeMutation,
+// so that identical mutations get the same node number
+// entries live in a flat open addressing hash table, and Mark/Sweep drop the ones whose edge isn't part of any genome anymore
+// (that edge can then only come back as a new edge, which gets split into a new node)
+//
+// for mutating on multiple threads, Find is safe to call concurrently as long as nothing gets inserted,
+// and new nodes are requested through proposals: every thread writes to its own slots with Propose,
+// and ResolveProposals then numbers them in slot order on one thread (so the numbering doesn't depend on the threads)
+class InnovationRegistry {
+public:
+	int Find(int from, int to, bool recurrent) const; // returns -1 if the edge hasn't been split
+	void Insert(int from, int to, bool recurrent, int node);
+	void Clear();
+
+	int GetSize() const; // for debugging (number of entries)
+	size_t GetNumBytes() const; // for debugging (memory used by the table)
+
+	// pruning: call Mark for every gene of every living genome and then Sweep to drop the unmarked entries
+	void Mark(int from, int to, bool recurrent);
+	int Sweep(); // returns the number of entries that were dropped
+
+	void BeginProposals(int num_slots); // clears the proposals of the last round
+	void Propose(int slot, int from, int to, bool recurrent); // thread-safe as long as each slot is only written by one thread
+	void ResolveProposals(int& node_ctr); // edges that aren't in the registry yet get ++node_ctr (the same edge proposed twice gets the same node)
+	int GetProposedNode(int slot) const; // after ResolveProposals (-1 if nothing was proposed in the slot)
+
+	// same layout as the forward and recurrent std::maps that NEAT used to save (so old files can still be loaded)
+	// entries are written sorted, so the files don't depend on the table layout
+	void Load(std::ifstream& file);
+	void Save(std::ofstream& file) const;
+
+private:
+	static constexpr unsigned long long EMPTY_KEY = ~0ull;
+	static constexpr int MIN_CAPACITY = 16;
+
+	struct Entry {
+		unsigned long long key = EMPTY_KEY;
+		int node = 0;
+		bool marked = false;
+	};
+
+	std::vector<Entry> entries; // size is a power of 2 (or 0), at most half full
+	int size = 0;
+
+	struct Proposal {
+		int from = -1; // -1 if the slot is unused
+		int to = 0;
+		bool recurrent = false;
+		int node = -1; // set by ResolveProposals
+	};
+	std::vector<Proposal> proposals;
+
+	static unsigned long long GetKey(int from, int to, bool recurrent); // (node ids are non-negative)
+	size_t FindSlot(unsigned long long key) const; // slot holding key, or the empty slot where it would go
+	void Rehash(size_t capacity);
+};
@@ -23,7 +23,9 @@
 */
 
 #include "MathHelpers.h"
+#include "Random.h"
 #include <utility>
+#include <cmath>
 
 float NEATMathHelpers::clamp(const float& val, const float& min_val, const float& max_val) {
 	if (val < min_val) return min_val;
@@ -42,14 +44,12 @@ int NEATMathHelpers::lerp(const int& a, const int& b, const float& alpha) {
 }
 
 double NEATMathHelpers::rand_norm() {
-	return ((double)rand() / RAND_MAX);
+	return NEATRandom::GetEngine().Uniform();
 }
 
 // between 0 and max (inclusive)
 int NEATMathHelpers::rand_int(int max) {
-	const int ret_val = (max + 1) * rand_norm();
-	if (ret_val > max) return max;
-	return ret_val;
+	return NEATRandom::GetEngine().UniformInt(max);
 }
 
 int NEATMathHelpers::rand_int(int min, int max) {
@@ -57,15 +57,36 @@ int NEATMathHelpers::rand_int(int min, int max) {
 }
 
 double NEATMathHelpers::randomGaussian(double stdDev) {
-	double u, v, s;
+	return stdDev * NEATRandom::GetEngine().Gaussian();
+}
+
+unsigned short NEATMathHelpers::FloatToHalf(float val) {
+	unsigned int bits;
+	memcpy(&bits, &val, sizeof(float));
+	const unsigned int sign = bits & 0x80000000u;
+	bits ^= sign;
 
-	do
-	{
-		u = 2.0 * ((double)rand() / RAND_MAX) - 1.0;
-		v = 2.0 * ((double)rand() / RAND_MAX) - 1.0;
-		s = u * u + v * v;
-	} while (s >= 1 || s == 0);
+	unsigned short ret_val;
+	if (bits >= (255u << 23)) { // inf or NaN
+		ret_val = (bits > (255u << 23)) ? 0x7e00 : 0x7c00;
+	}
+	else if (bits >= (143u << 23)) { // too large (becomes inf)
+		ret_val = 0x7c00;
+	}
+	else if (bits < (113u << 23)) { // becomes a denormal or zero
+		float f;
+		memcpy(&f, &bits, sizeof(float));
+		f += 0.5f; // let the FPU do the rounding
+		unsigned int denormBits;
+		memcpy(&denormBits, &f, sizeof(float));
+		ret_val = (unsigned short)(denormBits - (126u << 23));
+	}
+	else {
+		const unsigned int mantOdd = (bits >> 13) & 1; // resulting mantissa is odd
+		bits += ((unsigned int)(15 - 127) << 23) + 0xfff; // update exponent and rounding bias part 1
+		bits += mantOdd; // rounding bias part 2
+		ret_val = (unsigned short)(bits >> 13);
+	}
 
-	s = sqrt(-2.0 * log(s) / s);
-	return stdDev * u * s;
+	return ret_val | (unsigned short)(sign >> 16);
 }
\ No newline at end of file
@@ -24,6 +24,9 @@
 
 #pragma once
 
+#include <cstring>
+
+// the random functions draw from NEATRandom::GetEngine() (thread-safe; seed with NEATRandom::SetSeed)
 namespace NEATMathHelpers {
 	float clamp(const float& val, const float& min_val = 0.0f, const float& max_val = 1.0f);
 
@@ -41,4 +44,29 @@ namespace NEATMathHelpers {
 	int rand_int(int min, int max);
 
 	double randomGaussian(double stdDev);
+
+	// IEEE half precision conversion (rounds to nearest even)
+	unsigned short FloatToHalf(float val);
+
+	// defined inline since it's used in the inference loop
+	inline float HalfToFloat(unsigned short val) {
+		const unsigned int shiftedExp = 0x7c00u << 13; // exponent mask after shift
+		unsigned int bits = (val & 0x7fffu) << 13; // exponent/mantissa bits
+		const unsigned int exp = shiftedExp & bits;
+		bits += (127 - 15) << 23; // exponent adjust
+		if (exp == shiftedExp) { // inf/NaN
+			bits += (128 - 16) << 23;
+		}
+		else if (exp == 0) { // zero/denormal
+			bits += 1 << 23;
+			float f;
+			memcpy(&f, &bits, sizeof(float));
+			f -= 6.10351563e-05f; // renormalize (2^-14)
+			memcpy(&bits, &f, sizeof(float));
+		}
+		bits |= (unsigned int)(val & 0x8000u) << 16; // sign bit
+		float ret_val;
+		memcpy(&ret_val, &bits, sizeof(float));
+		return ret_val;
+	}
 }
\ No newline at end of file
@@ -24,10 +24,12 @@
 
 #include "NEAT.h"
 #include "MathHelpers.h"
-#include "SerializeMap.h"
+#include "Random.h"
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <thread>
 
 NEAT::NEAT(int input_size, int output_size, int pop_size_in, float compatibility_thresh_in, float c1_c2_in, float c3_in, float top_p_cutoff_in, float add_node_mutation_prob_in, float add_edge_mutation_prob_in, float weight_mutation_prob_in)
 	: fitness_valid_ptr{ std::make_shared<int>() },
@@ -79,25 +81,26 @@ NEAT::NEAT(int input_size, int output_size, int pop_size_in, float compatibility
 }
 
 bool NEAT::WithinCompatibilityThresh(const Genome& g1, const Genome& g2) const {
-	int nonMatching;
-	int genomeSize;
-	float avgWeightDiff;
-	g1.GetCompatibilityDistInfo(g2, nonMatching, genomeSize, avgWeightDiff);
-
-	const float compatibility_dist = (genomeSize <= 0) ? 0 : ((c1_c2 * nonMatching) / genomeSize + c3 * avgWeightDiff);
-	return compatibility_dist < compatibility_thresh;
+	return g1.GetCompatibilityDist(g2, c1_c2, c3, compatibility_thresh) < compatibility_thresh;
 }
 
 int NEAT::GetAddNodeNumber(std::pair<int, int> oldConnection, bool isRecurrent) {
-	std::map<std::pair<int, int>, int>& connectNode = isRecurrent ? recurrentConnectNode : forwardConnectNode;
-
-	auto it = connectNode.find(oldConnection);
-	if (it != connectNode.end()) return it->second;
+	const int node = innovations.Find(oldConnection.first, oldConnection.second, isRecurrent);
+	if (node >= 0) return node;
 
-	connectNode[oldConnection] = ++node_ctr;
+	innovations.Insert(oldConnection.first, oldConnection.second, isRecurrent, ++node_ctr);
 	return node_ctr;
 }
 
+void NEAT::PruneInnovations() {
+	for (auto& specie : species) {
+		for (auto& organism : specie.organisms) {
+			organism.GetGenome().MarkInnovations(innovations);
+		}
+	}
+	innovations.Sweep();
+}
+
 void NEAT::AddGenome(std::vector<Specie>& newSpecies, const Genome& childGenome) {
 	// check which specie child belongs to using compatibility threshold (may result in creation of new species)
 	bool foundSpecie = false;
@@ -116,6 +119,16 @@ void NEAT::AddGenome(std::vector<Specie>& newSpecies, const Genome& childGenome)
 	}
 }
 
+// stream of NEATRandom for a child (depends on the generation, the specie and the index of the child, so not on the thread that creates it)
+static unsigned long long GetChildStream(int generation, int specie_id, int child) {
+	unsigned long long key = ((unsigned long long)(unsigned int)generation << 32) | (unsigned int)specie_id;
+	key ^= (unsigned long long)(unsigned int)child * 0x9E3779B97F4A7C15ULL;
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+	key ^= key >> 31;
+	return key >> 1; // (ScopedStream streams are below 2^63)
+}
+
 bool NEAT::UpdateGeneration() {
 	// species for next generation
 	// species from last generation are copied in, and new species get appended to the end
@@ -149,7 +162,27 @@ bool NEAT::UpdateGeneration() {
 		sort(specie.organisms.begin(), specie.organisms.end()); // sort by decreasing fitness
 	}
 
-	// create offspring (added into newSpecies)
+	if (use_fitness_memo) { // remember the fitnesses for the organisms that come out unchanged
+		fitness_memo.clear();
+		for (auto& specie : species) {
+			for (auto& organism : specie.organisms) {
+				fitness_memo.emplace(organism.fingerprint, organism.fitness);
+			}
+		}
+	}
+
+	// create offspring (added into newSpecies once they've all been created)
+	// the number of offspring of each specie is worked out first, and then the children are created in parallel (see SetNumThreads)
+	// every child draws from its own stream of NEATRandom, so the children don't depend on the number of threads
+	// new nodes from add node mutations get numbered afterwards through the proposals of InnovationRegistry, in the order of the children
+	struct Offspring {
+		int specie; // index into species
+		int child; // index among the offspring of the specie
+		int max_parent_index; // parents are picked from the top organisms of the specie
+		bool champion; // copied unchanged
+	};
+	std::vector<Offspring> offspring;
+	offspring.reserve(pop_size + species.size()); // (upper bound on the number of children since numOffspring gets rounded)
 	for (size_t i = 0; i < species.size(); ++i) {
 		Specie& specie = species[i];
 		int numOffspring = 0;
@@ -162,12 +195,6 @@ bool NEAT::UpdateGeneration() {
 
 		if (numOffspring < 1) continue;
 
-		// top organism (a.k.a. champion) of each specie is copied unchanged if numOffspring > 5
-		if (numOffspring > 5) {
-			AddGenome(newSpecies, specie.organisms[0].GetGenome());
-			--numOffspring;
-		}
-
 		// top organisms used to create offspring (defaults to top 60%)
 		int topOrganismsSize = specie.organisms.size() * top_p_cutoff + 0.5f;
 		if (topOrganismsSize <= 0 || topOrganismsSize >= specie.organisms.size()) {
@@ -175,38 +202,98 @@ bool NEAT::UpdateGeneration() {
 		}
 		topOrganismsSize -= 1; // convert it into max index
 
-		// create offspring
-		for (int offspringCreated = 0; offspringCreated < numOffspring; ++offspringCreated) {
-			int parent1_index = NEATMathHelpers::rand_int(topOrganismsSize);
-			int parent2_index = NEATMathHelpers::rand_int(topOrganismsSize);
-
-			// parent1 is the more fit parent (child inherits structure of more fit parent)
-			//if (specie.organisms[parent2_index].fitness > specie.organisms[parent1_index].fitness) {
-			if (parent1_index > parent2_index) { // since organisms have been sorted by decreasing fitness
-				int temp_index = parent1_index;
-				parent2_index = parent1_index;
-				parent1_index = temp_index;
-			}
+		// top organism (a.k.a. champion) of each specie is copied unchanged if numOffspring > 5
+		const bool copyChampion = numOffspring > 5;
+		for (int j = 0; j < numOffspring; ++j) {
+			offspring.push_back({ (int)i, j, topOrganismsSize, copyChampion && j == 0 });
+		}
+	}
 
-			// cross-over parents to create child genome
-			Genome childGenome = specie.organisms[parent1_index].GetGenome();
-			if (parent1_index != parent2_index) childGenome.Crossover(specie.organisms[parent2_index].GetGenome()); // check index equality as an optimization
+	struct NodeMutation {
+		int from = -1; // -1 if the child didn't pick one
+		int to = 0;
+		bool recurrent = false;
+	};
+	std::vector<std::unique_ptr<Genome>> children(offspring.size());
+	std::vector<NodeMutation> nodeMutations(offspring.size());
+	innovations.BeginProposals(offspring.size());
+	auto createChild = [&](int childIndex) { // only writes to the slots of childIndex, so it can run on any thread
+		const Offspring& e = offspring[childIndex];
+		const Specie& specie = species[e.specie];
+		if (e.champion) {
+			children[childIndex].reset(new Genome(specie.organisms[0].GetGenome()));
+			return;
+		}
 
-			// mutate child genome
+		NEATRandom::ScopedStream stream(GetChildStream(generation_id, specie.specie_id, e.child));
+		int parent1_index = NEATMathHelpers::rand_int(e.max_parent_index);
+		int parent2_index = NEATMathHelpers::rand_int(e.max_parent_index);
 
-			if (NEATMathHelpers::rand_norm() < add_node_mutation_prob) { // 3% chance by default
-				childGenome.AddNodeMutation(*this); // add new node
-			}
-			else if (NEATMathHelpers::rand_norm() < add_edge_mutation_prob) { // 30% chance by default
-				childGenome.AddEdgeMutation(childGenome.GenerateNetwork(), 2); // add new edge
-			}
-			else if (NEATMathHelpers::rand_norm() < weight_mutation_prob) { // 80% chance by default
-				childGenome.MutateWeights(0.1f, 2.f, 0.1f); // mutate connection weights
+		// parent1 is the more fit parent (child inherits structure of more fit parent)
+		//if (specie.organisms[parent2_index].fitness > specie.organisms[parent1_index].fitness) {
+		if (parent1_index > parent2_index) { // since organisms have been sorted by decreasing fitness
+			int temp_index = parent1_index;
+			parent2_index = parent1_index;
+			parent1_index = temp_index;
+		}
+
+		// cross-over parents to create child genome
+		children[childIndex].reset(new Genome(specie.organisms[parent1_index].GetGenome()));
+		Genome& childGenome = *children[childIndex];
+		if (parent1_index != parent2_index) childGenome.Crossover(specie.organisms[parent2_index].GetGenome()); // check index equality as an optimization
+
+		// mutate child genome
+
+		if (NEATMathHelpers::rand_norm() < add_node_mutation_prob) { // 3% chance by default
+			NodeMutation& mutation = nodeMutations[childIndex];
+			if (childGenome.PickNodeMutation(mutation.from, mutation.to, mutation.recurrent)) { // add new node (once it's numbered)
+				innovations.Propose(childIndex, mutation.from, mutation.to, mutation.recurrent);
 			}
+		}
+		else if (NEATMathHelpers::rand_norm() < add_edge_mutation_prob) { // 30% chance by default
+			childGenome.AddEdgeMutation(2); // add new edge
+		}
+		else if (NEATMathHelpers::rand_norm() < weight_mutation_prob) { // 80% chance by default
+			childGenome.MutateWeights(0.1f, 2.f, 0.1f); // mutate connection weights
+		}
+	};
 
-			AddGenome(newSpecies, childGenome); // save childGenome into newSpecies
+	const int numWorkers = std::min<int>(num_threads, (offspring.size() + MIN_CHILDREN_PER_THREAD - 1) / MIN_CHILDREN_PER_THREAD);
+	if (numWorkers <= 1) {
+		for (int i = 0; i < (int)offspring.size(); ++i) {
+			createChild(i);
 		}
+	}
+	else {
+		// workers grab small batches of children until there are none left (the calling thread is one of them)
+		std::atomic<int> nextChild{ 0 };
+		auto work = [&]() {
+			const int batchSize = 8;
+			for (int start = nextChild.fetch_add(batchSize); start < (int)offspring.size(); start = nextChild.fetch_add(batchSize)) {
+				const int end = std::min<int>(start + batchSize, offspring.size());
+				for (int i = start; i < end; ++i) {
+					createChild(i);
+				}
+			}
+		};
+		std::vector<std::thread> workers;
+		for (int i = 1; i < numWorkers; ++i) {
+			workers.emplace_back(work);
+		}
+		work();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	innovations.ResolveProposals(node_ctr);
+	for (size_t i = 0; i < children.size(); ++i) {
+		const NodeMutation& e = nodeMutations[i];
+		if (e.from >= 0) children[i]->ApplyNodeMutation(e.from, e.to, e.recurrent, innovations.GetProposedNode(i));
+	}
 
+	for (auto& e : children) {
+		AddGenome(newSpecies, *e); // save child genome into newSpecies
 	}
 
 	// update species
@@ -219,23 +306,111 @@ bool NEAT::UpdateGeneration() {
 		}
 	}
 
+	PruneInnovations();
+
 	++generation_id;
 	return true;
 }
 
-std::vector<std::tuple<NetworkBaseVisual, FitnessInterface, int>> NEAT::GenerateNetworks() {
-	std::vector<std::tuple<NetworkBaseVisual, FitnessInterface, int>> retVal;
+// helpers for GenerateNetworks (one for each type of network)
+static void CompileNetwork(const Genome& genome, const Genome::OptimizeSettings* optimize, NetworkBaseVisual& network_out, Genome::OptimizeReport& report_out) {
+	const auto network = genome.GenerateNetwork(optimize);
+	report_out = network.GetOptimizeReport();
+	network_out = network;
+}
+
+static void CompileNetwork(const Genome& genome, const Genome::OptimizeSettings* optimize, NetworkBase& network_out, Genome::OptimizeReport& report_out) {
+	network_out = genome.GenerateNetworkBase(optimize, &report_out);
+}
+
+template<typename NetworkType>
+std::vector<std::tuple<NetworkType, FitnessInterface, int>> NEAT::GenerateNetworks(std::unordered_map<unsigned long long, CachedNetwork<NetworkType>>& cache) {
+	std::vector<std::tuple<NetworkType, FitnessInterface, int>> retVal;
+	std::unordered_map<unsigned long long, CachedNetwork<NetworkType>> newCache; // only the networks of this generation are kept
+	optimize_report = Genome::OptimizeReport();
+	num_reused_networks = 0;
 	for (auto& specie : species) {
 		for (auto& organism : specie.organisms) {
-			retVal.emplace_back(organism.GetGenome().GenerateNetwork(), FitnessInterface(fitness_valid_ptr, organism.fitness), specie.specie_id);
+			if (use_fitness_memo) {
+				auto memo = fitness_memo.find(organism.fingerprint);
+				if (memo != fitness_memo.end()) organism.fitness = memo->second;
+			}
+
+			auto cached = newCache.find(organism.fingerprint);
+			if (cached == newCache.end()) {
+				auto lastGeneration = cache.find(organism.fingerprint);
+				if (lastGeneration != cache.end()) {
+					cached = newCache.emplace(organism.fingerprint, std::move(lastGeneration->second)).first;
+					++num_reused_networks;
+				}
+				else {
+					cached = newCache.emplace(organism.fingerprint, CachedNetwork<NetworkType>()).first;
+					CompileNetwork(organism.GetGenome(), optimize_networks ? &optimize_settings : nullptr, cached->second.network, cached->second.report);
+				}
+			}
+			else ++num_reused_networks;
+
+			optimize_report += cached->second.report;
+			retVal.emplace_back(cached->second.network, FitnessInterface(fitness_valid_ptr, organism.fitness), specie.specie_id);
 		}
 	}
+	cache = std::move(newCache);
 	return retVal;
 }
 
+std::vector<std::tuple<NetworkBaseVisual, FitnessInterface, int>> NEAT::GenerateNetworks() {
+	return GenerateNetworks(visual_network_cache);
+}
+
+std::vector<std::tuple<NetworkBase, FitnessInterface, int>> NEAT::GenerateLeanNetworks() {
+	return GenerateNetworks(lean_network_cache);
+}
+
+NetworkBaseVisual NEAT::GenerateVisualNetwork(int network_index) const {
+	for (auto& specie : species) {
+		if (network_index < (int)specie.organisms.size()) {
+			if (network_index < 0) break;
+			return specie.organisms[network_index].GetGenome().GenerateNetwork(optimize_networks ? &optimize_settings : nullptr);
+		}
+		network_index -= specie.organisms.size();
+	}
+
+	std::cerr << "GenerateVisualNetwork failed since there's no network with that index" << std::endl;
+	return NetworkBaseVisual();
+}
+
+void NEAT::SetNetworkOptimization(bool enabled, const Genome::OptimizeSettings& settings) {
+	optimize_networks = enabled;
+	optimize_settings = settings;
+	visual_network_cache.clear(); // (compiled with the old settings)
+	lean_network_cache.clear();
+}
+
+void NEAT::SetNumThreads(int n) {
+	if (n <= 0) n = std::thread::hardware_concurrency();
+	num_threads = std::max(n, 1); // (hardware_concurrency can return 0)
+}
+
+int NEAT::GetNumReusedNetworks() const {
+	return num_reused_networks;
+}
+
+void NEAT::SetFitnessMemo(bool enabled) {
+	use_fitness_memo = enabled;
+	fitness_memo.clear();
+}
+
+const Genome::OptimizeReport& NEAT::GetOptimizeReport() const {
+	return optimize_report;
+}
+
 FitnessInterface::FitnessInterface(const std::shared_ptr<int>& fitness_valid_ptr_in, float& fitness_ref_in)
 	: fitness_valid_ptr{ fitness_valid_ptr_in }, fitness_ref{ fitness_ref_in } {}
 
+bool FitnessInterface::HasFitness() const {
+	return !fitness_valid_ptr.expired() && fitness_ref >= 0;
+}
+
 bool FitnessInterface::SetFitness(float f) {
 	if (fitness_valid_ptr.expired()) { // if fitness_ref is no longer valid, it will print an error and do nothing
 		std::cerr << "SetFitness failed since organism no longer exists. Make sure to call SetFitness before UpdateGeneration." << std::endl;
@@ -257,6 +432,10 @@ int NEAT::GetNumSpecies() const {
 	return species.size();
 }
 
+int NEAT::GetNumInnovations() const {
+	return innovations.GetSize();
+}
+
 void NEAT::PrintSpecieInfo() const {
 	std::cout << "{SpecieID,SpecieSize}:";
 	for (auto& e : species) {
@@ -265,7 +444,7 @@ void NEAT::PrintSpecieInfo() const {
 	std::cout << std::endl;
 }
 
-NEAT::Organism::Organism(std::ifstream& file) : genome{ file } {
+NEAT::Organism::Organism(std::ifstream& file) : genome{ file }, fingerprint{ genome.GetFingerprint() } {
 	file.read((char*)(&fitness), sizeof(float));
 }
 
@@ -317,8 +496,7 @@ bool NEAT::Load(const char* fname) {
 	file.read((char*)(&weight_mutation_prob), sizeof(float));
 	file.read((char*)(&generation_id), sizeof(int));
 
-	NEATSerializeMap::LoadMap(forwardConnectNode, file);
-	NEATSerializeMap::LoadMap(recurrentConnectNode, file);
+	innovations.Load(file);
 
 	int speciesSize;
 	file.read((char*)(&speciesSize), sizeof(int));
@@ -330,6 +508,9 @@ bool NEAT::Load(const char* fname) {
 
 	file.close();
 
+	PruneInnovations(); // (older files kept every split edge)
+	fitness_memo.clear(); // (fitnesses of another run)
+
 	return true;
 }
 
@@ -348,8 +529,7 @@ void NEAT::Save(const char* fname) const {
 	file.write((const char*)(&weight_mutation_prob), sizeof(float));
 	file.write((const char*)(&generation_id), sizeof(int));
 
-	NEATSerializeMap::SaveMap(forwardConnectNode, file);
-	NEATSerializeMap::SaveMap(recurrentConnectNode, file);
+	innovations.Save(file);
 
 	int speciesSize = species.size();
 	file.write((const char*)(&speciesSize), sizeof(int));
@@ -25,6 +25,7 @@
 #pragma once
 
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include "Genome.h"
 
@@ -35,6 +36,7 @@ class FitnessInterface {
 public:
 	FitnessInterface(const std::shared_ptr<int>& fitness_valid_ptr_in, float& fitness_ref_in);
 	bool SetFitness(float f);
+	bool HasFitness() const; // true once the fitness is set (or if it was filled in by the fitness memo, see NEAT::SetFitnessMemo)
 
 private:
 	std::weak_ptr<int> fitness_valid_ptr;
@@ -50,10 +52,34 @@ public:
 	void Save(const char* fname) const;
 
 	std::vector<std::tuple<NetworkBaseVisual, FitnessInterface, int>> GenerateNetworks(); // generate networks for the current organisms
+	// same as GenerateNetworks but without the visualization information (less memory and faster to build when nothing gets visualized)
+	std::vector<std::tuple<NetworkBase, FitnessInterface, int>> GenerateLeanNetworks();
+	// visualization information for a single network (e.g. the best one) after calling GenerateLeanNetworks
+	// network_index is the index into the output of GenerateNetworks or GenerateLeanNetworks (only valid until UpdateGeneration)
+	NetworkBaseVisual GenerateVisualNetwork(int network_index) const;
+
+	// runs the optimization pass of Genome::Network on the networks from GenerateNetworks (off by default)
+	// leaves out dead and constant structure, so turn it off to visualize the full genomes
+	void SetNetworkOptimization(bool enabled, const Genome::OptimizeSettings& settings = Genome::OptimizeSettings());
+	const Genome::OptimizeReport& GetOptimizeReport() const; // for debugging (totals of the last call to GenerateNetworks or GenerateLeanNetworks)
+
+	// organisms that come out of UpdateGeneration unchanged (e.g. the champions) reuse the network they had in the last call to
+	// GenerateNetworks or GenerateLeanNetworks instead of compiling it again (genomes are matched by Genome::GetFingerprint)
+	int GetNumReusedNetworks() const; // for debugging (networks that were reused by the last call)
+
+	// fitness memo for deterministic fitness functions (off by default)
+	// GenerateNetworks and GenerateLeanNetworks fill in the fitness of organisms whose network was evaluated in the previous generation,
+	// so only the networks where FitnessInterface::HasFitness is false need to be evaluated (setting the fitness again is fine too)
+	void SetFitnessMemo(bool enabled);
 	bool UpdateGeneration(); // fitnesses should be set before calling this; returns true on success and false on failure
 
+	// number of threads UpdateGeneration creates the offspring on (1 by default; 0 uses one per hardware thread)
+	// every child draws from a stream of NEATRandom picked by the generation, its specie and its index, so the result is the same for any number of threads
+	void SetNumThreads(int n);
+
 	int GetGenerationID() const; // for debugging
 	int GetNumSpecies() const; // for debugging
+	int GetNumInnovations() const; // for debugging (number of split edges that are remembered)
 	void PrintSpecieInfo() const; // for debugging
 
 	int GetAddNodeNumber(std::pair<int, int> oldConnection, bool isRecurrent); // used by Genome::AddNodeMutation; shouldn't need to call this directly
@@ -64,7 +90,8 @@ private:
 		Genome genome;
 	public:
 		float fitness = -1; // gets set by test environment to a value >= 0
-		Organism(const Genome& parent) : genome{ parent } {}
+		unsigned long long fingerprint = 0; // of the genome (which doesn't change once it's part of an organism)
+		Organism(const Genome& parent) : genome{ parent }, fingerprint{ parent.GetFingerprint() } {}
 		Organism(std::ifstream& file);
 
 		void Save(std::ofstream& file) const;
@@ -92,8 +119,8 @@ private:
 	void AddGenome(std::vector<Specie>& newSpecies, const Genome& childGenome);
 
 	int node_ctr = 0; // initialized in ctor
-	std::map<std::pair<int, int>, int> forwardConnectNode; // map for getting node numbers when adding a new node
-	std::map<std::pair<int, int>, int> recurrentConnectNode; // map for getting node numbers when adding a new node
+	InnovationRegistry innovations; // for getting node numbers when adding a new node (pruned after every generation)
+	void PruneInnovations(); // drops the split edges that no genome has anymore
 
 	int species_ctr = -1;
 	std::vector<Specie> species;
@@ -108,4 +135,26 @@ private:
 	float weight_mutation_prob;
 
 	int generation_id = 0; // for debugging
+
+	bool optimize_networks = false;
+	Genome::OptimizeSettings optimize_settings;
+	Genome::OptimizeReport optimize_report;
+
+	// networks of the last call to GenerateNetworks or GenerateLeanNetworks by fingerprint (copies share their arrays, so this is cheap)
+	template<typename NetworkType>
+	struct CachedNetwork {
+		NetworkType network; // never run, so copies start from a reset state
+		Genome::OptimizeReport report;
+	};
+	std::unordered_map<unsigned long long, CachedNetwork<NetworkBaseVisual>> visual_network_cache;
+	std::unordered_map<unsigned long long, CachedNetwork<NetworkBase>> lean_network_cache;
+	int num_reused_networks = 0;
+	template<typename NetworkType>
+	std::vector<std::tuple<NetworkType, FitnessInterface, int>> GenerateNetworks(std::unordered_map<unsigned long long, CachedNetwork<NetworkType>>& cache); // helper for both versions
+
+	int num_threads = 1;
+	static constexpr int MIN_CHILDREN_PER_THREAD = 64; // (fewer children aren't worth starting a thread for)
+
+	bool use_fitness_memo = false;
+	std::unordered_map<unsigned long long, float> fitness_memo; // fitnesses of the last generation by fingerprint
 };
\ No newline at end of file
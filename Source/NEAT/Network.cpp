@@ -27,8 +27,15 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cstring>
 #include "MathHelpers.h"
-#include <deque>
+#include "SIMD.h"
+#include "NetworkFile.h"
+
+// blocks become dense when at least this fraction of their (node, distinct input) pairs have an edge
+static const float DENSE_BLOCK_MIN_DENSITY = 0.3f;
+// and when their weight matrix has at least this many entries (smaller blocks aren't worth gathering the inputs for)
+static const int DENSE_BLOCK_MIN_WEIGHTS = 32;
 
 bool NetworkBase::IsInputNode(int node_id) const {
 	return !((node_id < 0) || (node_id >= num_input_nodes));
@@ -44,8 +51,13 @@ bool NetworkBase::IsInvalid() const {
 
 NetworkBase::NetworkBase()
 	: num_input_nodes{ 0 }, num_output_nodes{ 0 },
-	input_info{ std::make_shared<std::vector<NeuronInputInfo>>() },
-	output_indices{ std::make_shared<std::vector<int>>() } {}
+	input_info{ std::make_shared<const NetworkArray<NeuronInputInfo>>() },
+	output_indices{ std::make_shared<const NetworkArray<int>>() },
+	node_activations{ std::make_shared<const NetworkArray<NEATActivation::Type>>() },
+	input_counts{ std::make_shared<const NetworkArray<int>>() },
+	block_info{ std::make_shared<const NetworkArray<NeuronBlockInfo>>() },
+	dense_sources{ std::make_shared<const NetworkArray<int>>() },
+	dense_weights{ std::make_shared<const NetworkArray<float>>() } {}
 
 NetworkBaseVisual::NetworkBaseVisual() {}
 
@@ -54,7 +66,7 @@ NetworkBase::NetworkBase(const char* fname) { Load(fname); }
 NetworkBaseVisual::NetworkBaseVisual(const char* fname) { Load(fname); }
 
 int NetworkBase::GetNumNodes() const {
-	return run_info.size();
+	return input_counts->size();
 }
 
 int NetworkBase::GetNumEdges() const {
@@ -67,39 +79,82 @@ bool NetworkBaseVisual::Save(const char* fname) const {
 		return false;
 	}
 
-	std::ofstream file{ fname, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc };
-
-	// save network base info
-	const int input_info_size = (*input_info).size();
-	const int output_indices_size = (*output_indices).size();
-	const int run_info_size = run_info.size();
-
-	file.write((const char*)(&num_input_nodes), sizeof(int));
-	file.write((const char*)(&num_output_nodes), sizeof(int));
-	file.write((const char*)(&input_info_size), sizeof(int));
-	file.write((const char*)(&output_indices_size), sizeof(int));
-	file.write((const char*)(&run_info_size), sizeof(int));
+	// the structs are written as they are laid out in memory so that they can be used in place when the file is mapped
+	static_assert(sizeof(NeuronInputInfo) == 8 && sizeof(NeuronBlockInfo) == 28 && sizeof(NeuronVisualInfo) == 16, "unexpected struct layout");
+	static_assert(sizeof(NEATActivation::Type) == 1, "unexpected activation size");
+
+	NEATNetworkFile::Writer writer;
+	writer.AddSection(NEATNetworkFile::Section::InputCounts, input_counts->data(), input_counts->size());
+	writer.AddSection(NEATNetworkFile::Section::InputInfo, input_info->data(), input_info->size());
+	writer.AddSection(NEATNetworkFile::Section::OutputIndices, output_indices->data(), output_indices->size());
+	writer.AddSection(NEATNetworkFile::Section::Activations, node_activations->data(), node_activations->size());
+	// structs with padding are copied field by field into zeroed records (so saving the same network always gives the same bytes)
+	std::vector<NeuronBlockInfo> blocks(block_info->size());
+	memset((void*)blocks.data(), 0, sizeof(NeuronBlockInfo) * blocks.size());
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		const NeuronBlockInfo& block = (*block_info)[i];
+		blocks[i].start_index = block.start_index;
+		blocks[i].size = block.size;
+		blocks[i].input_info_start_index = block.input_info_start_index;
+		blocks[i].activation = block.activation;
+		blocks[i].is_dense = block.is_dense;
+		blocks[i].num_sources = block.num_sources;
+		blocks[i].dense_source_start_index = block.dense_source_start_index;
+		blocks[i].dense_weight_start_index = block.dense_weight_start_index;
+	}
+	writer.AddSection(NEATNetworkFile::Section::Blocks, blocks.data(), blocks.size());
+	writer.AddSection(NEATNetworkFile::Section::DenseSources, dense_sources->data(), dense_sources->size());
+
+	// the compiled kernels are always saved with full precision weights
+	std::vector<float> fullDenseWeights;
+	std::vector<float> packedWeights;
+	const float* denseWeights = dense_weights->data();
+	if (half_precision_weights && packed_topology) {
+		NetworkBaseVisual fullPrecision = *this;
+		fullPrecision.SetHalfPrecisionWeights(false);
+		fullDenseWeights.assign(fullPrecision.dense_weights->begin(), fullPrecision.dense_weights->end());
+		denseWeights = fullDenseWeights.data();
+	}
+	writer.AddSection(NEATNetworkFile::Section::DenseWeights, denseWeights, dense_weights->size());
 
-	file.write((const char*)(&(*input_info)[0]), sizeof(NeuronInputInfo) * input_info_size);
-	file.write((const char*)(&(*output_indices)[0]), sizeof(int) * output_indices_size);
-	file.write((const char*)(&run_info[0]), sizeof(NeuronRunInfo) * run_info_size);
+	if (packed_topology) {
+		packedWeights.reserve(input_info->size());
+		for (auto& e : *input_info) {
+			packedWeights.emplace_back(e.weight);
+		}
+		writer.AddSection(NEATNetworkFile::Section::PackedCounts, packed_topology->input_counts.data(), packed_topology->input_counts.size());
+		writer.AddSection(NEATNetworkFile::Section::PackedIndices, packed_topology->input_indices.data(), packed_topology->input_indices.size());
+		writer.AddSection(NEATNetworkFile::Section::PackedWeights, packedWeights.data(), packedWeights.size());
+	}
 
 	// save visualization info
-	const int visual_info_size = visual_info.size();
-	const int layers = layer_sizes.size();
-
-	file.write((const char*)(&visual_info_size), sizeof(int));
-	file.write((const char*)(&layers), sizeof(int));
-
-	file.write((const char*)(&visual_info[0]), sizeof(NeuronVisualInfo) * visual_info_size);
-	file.write((const char*)(&layer_sizes[0]), sizeof(int) * layers);
-
-	file.close();
+	std::vector<NeuronVisualInfo> visualInfo(visual_info.size());
+	memset((void*)visualInfo.data(), 0, sizeof(NeuronVisualInfo) * visualInfo.size());
+	for (size_t i = 0; i < visualInfo.size(); ++i) {
+		visualInfo[i].label = visual_info[i].label;
+		visualInfo[i].layer_num = visual_info[i].layer_num;
+		visualInfo[i].layer_index = visual_info[i].layer_index;
+		visualInfo[i].is_output = visual_info[i].is_output;
+	}
+	writer.AddSection(NEATNetworkFile::Section::VisualInfo, visualInfo.data(), visualInfo.size());
+	writer.AddSection(NEATNetworkFile::Section::LayerSizes, layer_sizes.data(), layer_sizes.size());
 
-	return true;
+	return writer.Write(fname, num_input_nodes, num_output_nodes);
 }
 
 void NetworkBase::Load(const char* fname) {
+	auto mapping = NEATNetworkFile::MappedFile::Open(fname);
+	if (mapping && mapping->HasHeader()) {
+		if (!mapping->Validate() || !LoadMappedImpl(mapping)) {
+			std::cerr << "Failed to load " << fname << std::endl;
+			num_input_nodes = 0; // marks the network as invalid
+			num_output_nodes = 0;
+		}
+		return;
+	}
+	mapping = nullptr;
+
+	// original layout
 	std::ifstream file{ fname, std::ios::binary };
 	if (!file.is_open()) {
 		std::cerr << "Failed to open " << fname << std::endl;
@@ -112,10 +167,6 @@ void NetworkBase::Load(const char* fname) {
 }
 
 void NetworkBase::LoadImpl(std::ifstream& file) {
-	// create new shared ptrs so that other networks don't get corrupted
-	input_info = std::make_shared<std::vector<NeuronInputInfo>>();
-	output_indices = std::make_shared<std::vector<int>>();
-
 	int input_info_size;
 	int output_indices_size;
 	int run_info_size;
@@ -126,17 +177,178 @@ void NetworkBase::LoadImpl(std::ifstream& file) {
 	file.read((char*)(&output_indices_size), sizeof(int));
 	file.read((char*)(&run_info_size), sizeof(int));
 
-	(*input_info).resize(input_info_size);
-	(*output_indices).resize(output_indices_size);
-	run_info.resize(run_info_size);
+	std::vector<NeuronInputInfo> new_input_info(input_info_size);
+	std::vector<int> new_output_indices(output_indices_size);
+	std::vector<NeuronRunInfo> run_info(run_info_size);
 
-	file.read((char*)(&(*input_info)[0]), sizeof(NeuronInputInfo) * input_info_size);
-	file.read((char*)(&(*output_indices)[0]), sizeof(int) * output_indices_size);
+	file.read((char*)(&new_input_info[0]), sizeof(NeuronInputInfo) * input_info_size);
+	file.read((char*)(&new_output_indices[0]), sizeof(int) * output_indices_size);
 	file.read((char*)(&run_info[0]), sizeof(NeuronRunInfo) * run_info_size);
 
+	// unpack input counts and activation ids (the top byte of input_info_block_size holds the activation; files without one have 0 there, which is tanh)
+	std::vector<int> new_input_counts(run_info_size);
+	std::vector<NEATActivation::Type> new_activations(run_info_size);
+	for (int i = 0; i < run_info_size; ++i) {
+		int activation = (run_info[i].input_info_block_size >> 24) & 0xff;
+		new_input_counts[i] = run_info[i].input_info_block_size & 0xffffff;
+		if (activation >= (int)NEATActivation::Type::Count) {
+			std::cerr << "Found unknown activation " << activation << " while loading network; using tanh instead" << std::endl;
+			activation = (int)NEATActivation::Type::Tanh;
+		}
+		new_activations[i] = IsInputNode(i) ? NEATActivation::Type::Identity : (NEATActivation::Type)activation;
+	}
+
+	SortInputInfo(new_input_info, new_input_counts);
+
+	// new shared ptrs so that other networks don't get corrupted
+	input_info = MakeSharedNetworkArray(std::move(new_input_info));
+	output_indices = MakeSharedNetworkArray(std::move(new_output_indices));
+	node_activations = MakeSharedNetworkArray(std::move(new_activations));
+	input_counts = MakeSharedNetworkArray(std::move(new_input_counts));
+
+	BuildBlocks();
 	ResetRecurrentConnections();
 }
 
+bool NetworkBase::LoadMappedImpl(const std::shared_ptr<const NEATNetworkFile::MappedFile>& mapping) {
+	using NEATNetworkFile::MappedFile;
+	using NEATNetworkFile::Section;
+
+	const NEATNetworkFile::Header& header = mapping->GetHeader();
+	num_input_nodes = header.num_input_nodes;
+	num_output_nodes = header.num_output_nodes;
+
+	// everything immutable points into the mapping; only node_vals gets allocated
+	input_counts = MappedFile::GetSharedArray<int>(mapping, Section::InputCounts);
+	input_info = MappedFile::GetSharedArray<NeuronInputInfo>(mapping, Section::InputInfo);
+	output_indices = MappedFile::GetSharedArray<int>(mapping, Section::OutputIndices);
+	node_activations = MappedFile::GetSharedArray<NEATActivation::Type>(mapping, Section::Activations);
+	block_info = MappedFile::GetSharedArray<NeuronBlockInfo>(mapping, Section::Blocks);
+	dense_sources = MappedFile::GetSharedArray<int>(mapping, Section::DenseSources);
+	dense_weights = MappedFile::GetSharedArray<float>(mapping, Section::DenseWeights);
+	if (!input_counts || !input_info || !output_indices || !node_activations || !block_info || !dense_sources || !dense_weights) {
+		std::cerr << "Network file has a section with an invalid size" << std::endl;
+		return false;
+	}
+
+	// the checksum only catches corruption, so everything Run indexes with gets checked as well
+	const int numNodes = input_counts->size();
+	if (IsInvalid() || numNodes < num_input_nodes + num_output_nodes || (int)node_activations->size() != numNodes || (int)output_indices->size() != num_output_nodes) {
+		std::cerr << "Network file has inconsistent node counts" << std::endl;
+		return false;
+	}
+	size_t numEdges = 0;
+	for (auto e : *input_counts) {
+		if (e < 0) {
+			std::cerr << "Network file has a negative edge count" << std::endl;
+			return false;
+		}
+		numEdges += e;
+	}
+	if (numEdges != input_info->size()) {
+		std::cerr << "Network file has inconsistent edge counts" << std::endl;
+		return false;
+	}
+	for (auto e : *output_indices) {
+		if (e < num_input_nodes || e >= numNodes) {
+			std::cerr << "Network file has an invalid output index" << std::endl;
+			return false;
+		}
+	}
+	for (auto& e : *input_info) {
+		if (e.input_index < 0 || e.input_index >= numNodes) {
+			std::cerr << "Network file has an edge from a node that doesn't exist" << std::endl;
+			return false;
+		}
+	}
+	for (auto e : *node_activations) {
+		if ((int)e >= (int)NEATActivation::Type::Count) {
+			std::cerr << "Network file has an unknown activation" << std::endl;
+			return false;
+		}
+	}
+	int nextNode = num_input_nodes;
+	size_t nextEdge = 0;
+	for (int i = 0; i < num_input_nodes; ++i) {
+		nextEdge += (*input_counts)[i];
+	}
+	for (auto& block : *block_info) {
+		if (block.start_index != nextNode || block.size < 1 || block.start_index + block.size > numNodes || block.input_info_start_index != (int)nextEdge) {
+			std::cerr << "Network file has an invalid block" << std::endl;
+			return false;
+		}
+		for (int k = 0; k < block.size; ++k) {
+			nextEdge += (*input_counts)[block.start_index + k];
+		}
+		nextNode += block.size;
+		if (block.is_dense) {
+			const size_t numWeights = (size_t)block.num_sources * block.size;
+			if (block.num_sources < 1 || (size_t)block.dense_source_start_index + block.num_sources > dense_sources->size() || (size_t)block.dense_weight_start_index + numWeights > dense_weights->size()) {
+				std::cerr << "Network file has an invalid dense block" << std::endl;
+				return false;
+			}
+			for (int c = 0; c < block.num_sources; ++c) {
+				const int source = (*dense_sources)[block.dense_source_start_index + c];
+				if (source < 0 || source >= numNodes) {
+					std::cerr << "Network file has an invalid dense block" << std::endl;
+					return false;
+				}
+			}
+		}
+	}
+	if (nextNode != numNodes) {
+		std::cerr << "Network file has blocks that don't cover every node" << std::endl;
+		return false;
+	}
+
+	packed_topology = nullptr;
+	half_precision_weights = false;
+	if (header.sections[(int)Section::PackedCounts].size > 0) {
+		auto packed = std::make_shared<PackedTopology>();
+		if (!MappedFile::GetArray(mapping, Section::PackedCounts, packed->input_counts) ||
+			!MappedFile::GetArray(mapping, Section::PackedIndices, packed->input_indices) ||
+			!MappedFile::GetArray(mapping, Section::PackedWeights, packed->weights) ||
+			numNodes > 65535 || (int)packed->input_counts.size() != numNodes || packed->input_indices.size() != numEdges || packed->weights.size() != numEdges) {
+			std::cerr << "Network file has an invalid packed layout" << std::endl;
+			return false;
+		}
+		// the packed layout is a copy of input_counts and input_info, so it has to match them exactly
+		for (int i = 0; i < numNodes; ++i) {
+			if (packed->input_counts[i] != (*input_counts)[i]) {
+				std::cerr << "Network file has an invalid packed layout" << std::endl;
+				return false;
+			}
+		}
+		for (size_t i = 0; i < numEdges; ++i) {
+			if (packed->input_indices[i] != (*input_info)[i].input_index) {
+				std::cerr << "Network file has an invalid packed layout" << std::endl;
+				return false;
+			}
+		}
+		packed_topology = packed;
+	}
+
+	ResetRecurrentConnections();
+	return true;
+}
+
+bool NetworkBaseVisual::LoadMappedImpl(const std::shared_ptr<const NEATNetworkFile::MappedFile>& mapping) {
+	if (!NetworkBase::LoadMappedImpl(mapping)) return false;
+
+	// visualization info is mutable, so it gets copied out of the mapping
+	NetworkArray<NeuronVisualInfo> mappedVisualInfo;
+	NetworkArray<int> mappedLayerSizes;
+	if (!NEATNetworkFile::MappedFile::GetArray(mapping, NEATNetworkFile::Section::VisualInfo, mappedVisualInfo) ||
+		!NEATNetworkFile::MappedFile::GetArray(mapping, NEATNetworkFile::Section::LayerSizes, mappedLayerSizes) ||
+		mappedVisualInfo.size() != input_counts->size()) { // (visual_info is indexed by node)
+		std::cerr << "Network file has a section with an invalid size" << std::endl;
+		return false;
+	}
+	visual_info.assign(mappedVisualInfo.begin(), mappedVisualInfo.end());
+	layer_sizes.assign(mappedLayerSizes.begin(), mappedLayerSizes.end());
+	return true;
+}
+
 void NetworkBaseVisual::LoadImpl(std::ifstream& file) {
 	NetworkBase::LoadImpl(file);
 
@@ -157,192 +369,433 @@ void Genome::Network::LoadImpl(std::ifstream& file) {
 	std::cerr << "Load failed. Do not use the Network class; use NetworkBaseVisual or NetworkBase instead." << std::endl;
 }
 
+bool Genome::Network::LoadMappedImpl(const std::shared_ptr<const NEATNetworkFile::MappedFile>&) {
+	std::cerr << "Load failed. Do not use the Network class; use NetworkBaseVisual or NetworkBase instead." << std::endl;
+	return false;
+}
+
 // input_nodes must be >= 2 (we need at least one input to be useful, and an extra is used as a bias)
 // output_nodes must be >= 1
-Genome::Network::Network(int input_nodes, int output_nodes, const std::map<std::pair<int, int>, float>& forward_edges, const std::map<std::pair<int, int>, float>& recurrent_edges) {
+Genome::Network::Network(int input_nodes, int output_nodes, const std::vector<Gene>& genes, const OptimizeSettings* optimize, bool lean) {
 	num_input_nodes = input_nodes;
 	num_output_nodes = output_nodes;
 
-	// read into adjacency lists
-	//std::map<int,std::unordered_set<int>> adjacency_list; // now a member variable
-	std::map<int, std::unordered_set<int>> adjacency_list_rev; // gets mutated below during topological sort
-	for (int i = 0; i < (input_nodes + output_nodes); ++i) {
-		adjacency_list[i];
-		adjacency_list_rev[i];
+	if (optimize == nullptr) {
+		Build(input_nodes, output_nodes, genes, lean);
+		return;
+	}
+
+	auto optimizedGenes = genes;
+	optimize_report = Optimize(*optimize, optimizedGenes);
+	Build(input_nodes, output_nodes, optimizedGenes, lean);
+}
+
+const Genome::OptimizeReport& Genome::Network::GetOptimizeReport() const {
+	return optimize_report;
+}
+
+void Genome::OptimizeReport::operator+=(const OptimizeReport& other) {
+	removed_nodes += other.removed_nodes;
+	removed_edges += other.removed_edges;
+	folded_nodes += other.folded_nodes;
+}
+
+// counts the distinct nodes of a graph (helper for Genome::Network::Optimize)
+static int CountNodes(int fixed_nodes, const std::map<std::pair<int, int>, float>& forward_edges, const std::map<std::pair<int, int>, float>& recurrent_edges) {
+	std::unordered_set<int> nodes;
+	for (int i = 0; i < fixed_nodes; ++i) {
+		nodes.insert(i);
 	}
 	for (auto& e : forward_edges) {
-		auto fromNode = std::get<0>(e.first);
-		auto toNode = std::get<1>(e.first);
+		nodes.insert(e.first.first);
+		nodes.insert(e.first.second);
+	}
+	for (auto& e : recurrent_edges) {
+		nodes.insert(e.first.first);
+		nodes.insert(e.first.second);
+	}
+	return nodes.size();
+}
 
-		if (IsOutputNode(fromNode) && !IsOutputNode(toNode)) {
-			std::cerr << "Found output to non-output edge that isn't labelled as recurrent!" << std::endl;
-			return;
+Genome::OptimizeReport Genome::Network::Optimize(const OptimizeSettings& settings, std::vector<Gene>& genes) const {
+	// the passes below insert and erase edges, so they work on maps of the enabled genes
+	std::map<std::pair<int, int>, float> forward_edges;
+	std::map<std::pair<int, int>, float> recurrent_edges;
+	for (auto& e : genes) {
+		if (!e.enabled) continue;
+		(e.recurrent ? recurrent_edges : forward_edges)[{ e.from, e.to }] = e.weight;
+	}
+
+	const int fixedNodes = num_input_nodes + num_output_nodes; // inputs and outputs are never removed
+	const int biasNode = num_input_nodes - 1;
+	const int nodesBefore = CountNodes(fixedNodes, forward_edges, recurrent_edges);
+	const int edgesBefore = forward_edges.size() + recurrent_edges.size();
+	OptimizeReport report;
+
+	// drop negligible edges
+	if (settings.prune_weight >= 0) {
+		for (auto* edges : { &forward_edges, &recurrent_edges }) {
+			for (auto it = edges->begin(); it != edges->end();) {
+				if (std::fabs(it->second) <= settings.prune_weight) it = edges->erase(it);
+				else ++it;
+			}
+		}
+	}
+
+	// fold constants
+	// a hidden node is constant if it has no recurrent inputs and all of its inputs are the bias or other constants,
+	// in which case its forward edges get replaced by bias edges carrying its (precomputed) contribution
+	// (its recurrent edges have to stay since they read 0 on the first run after a reset)
+	if (settings.fold_constants) {
+		std::map<int, std::vector<std::pair<int, float>>> forwardInputs;
+		std::map<int, int> numForwardInputs; // for the topological sort
+		std::unordered_set<int> hasRecurrentInputs;
+		for (auto& e : forward_edges) {
+			forwardInputs[e.first.second].emplace_back(e.first.first, e.second);
+			++numForwardInputs[e.first.second];
+			numForwardInputs[e.first.first];
+		}
+		for (auto& e : recurrent_edges) {
+			hasRecurrentInputs.insert(e.first.second);
 		}
 
-		adjacency_list[fromNode].insert(toNode);
-		adjacency_list[toNode];
-		adjacency_list_rev[toNode].insert(fromNode);
-		adjacency_list_rev[fromNode];
+		std::map<int, std::vector<int>> forwardOutputs;
+		for (auto& e : forward_edges) {
+			forwardOutputs[e.first.first].emplace_back(e.first.second);
+		}
+		std::vector<int> sorted;
+		for (auto& e : numForwardInputs) {
+			if (e.second == 0) sorted.emplace_back(e.first);
+		}
+		for (size_t i = 0; i < sorted.size(); ++i) {
+			for (auto e : forwardOutputs[sorted[i]]) {
+				if (--numForwardInputs[e] == 0) sorted.emplace_back(e);
+			}
+		}
+
+		std::map<int, float> constantVals;
+		constantVals[biasNode] = 1;
+		for (auto node : sorted) {
+			if (node < fixedNodes || hasRecurrentInputs.count(node) > 0) continue;
+			float sum = 0;
+			bool isConstant = true;
+			for (auto& e : forwardInputs[node]) {
+				auto constantLookup = constantVals.find(e.first);
+				if (constantLookup == constantVals.end()) {
+					isConstant = false;
+					break;
+				}
+				sum += constantLookup->second * e.second;
+			}
+			if (isConstant) constantVals[node] = NEATActivation::Apply(NEATActivation::Type::Tanh, sum); // every node is compiled with tanh
+		}
+		constantVals.erase(biasNode);
+
+		std::unordered_set<int> foldedFrom;
+		for (auto it = forward_edges.begin(); it != forward_edges.end();) {
+			auto constantLookup = constantVals.find(it->first.first);
+			if (constantLookup == constantVals.end()) {
+				++it;
+				continue;
+			}
+			forward_edges[{ biasNode, it->first.second }] += constantLookup->second * it->second; // (inserting doesn't invalidate it)
+			foldedFrom.insert(it->first.first);
+			it = forward_edges.erase(it);
+		}
+
+		// constants that are no longer read by anything get removed along with their inputs
+		std::unordered_set<int> stillRead;
+		for (auto* edges : { &forward_edges, &recurrent_edges }) {
+			for (auto& e : *edges) {
+				stillRead.insert(e.first.first);
+			}
+		}
+		std::unordered_set<int> folded;
+		for (auto node : foldedFrom) {
+			if (stillRead.count(node) < 1) folded.insert(node);
+		}
+		for (auto it = forward_edges.begin(); it != forward_edges.end();) {
+			if (folded.count(it->first.second) > 0) it = forward_edges.erase(it);
+			else ++it;
+		}
+		report.folded_nodes = folded.size();
+	}
+
+	// remove every hidden node that can't reach an output
+	if (settings.remove_dead_nodes) {
+		std::map<int, std::vector<int>> inputs;
+		for (auto* edges : { &forward_edges, &recurrent_edges }) {
+			for (auto& e : *edges) {
+				inputs[e.first.second].emplace_back(e.first.first);
+			}
+		}
+
+		std::unordered_set<int> live;
+		std::vector<int> frontier;
+		for (int i = num_input_nodes; i < fixedNodes; ++i) {
+			live.insert(i);
+			frontier.emplace_back(i);
+		}
+		while (!frontier.empty()) {
+			const int curNode = frontier.back();
+			frontier.pop_back();
+			for (auto e : inputs[curNode]) {
+				if (live.insert(e).second) frontier.emplace_back(e);
+			}
+		}
+
+		for (auto* edges : { &forward_edges, &recurrent_edges }) {
+			for (auto it = edges->begin(); it != edges->end();) {
+				if (live.count(it->first.second) < 1) it = edges->erase(it);
+				else ++it;
+			}
+		}
+	}
+
+	report.removed_nodes = nodesBefore - CountNodes(fixedNodes, forward_edges, recurrent_edges);
+	report.removed_edges = edgesBefore - (int)(forward_edges.size() + recurrent_edges.size());
+
+	genes.clear();
+	for (auto* edges : { &forward_edges, &recurrent_edges }) {
+		for (auto& e : *edges) {
+			genes.emplace_back(e.first.first, e.first.second, e.second, true, edges == &recurrent_edges); // (stays sorted)
+		}
 	}
+	return report;
+}
 
-	std::map<int, std::unordered_set<int>> adjacency_list_rev_copy = adjacency_list_rev; // make a copy for after topological sort
+// scratch buffers for Genome::Network::Build (one set per thread, so compiling doesn't allocate once they're big enough)
+// nodes get dense indices in the order of their ids, and the forward edges are kept as compressed sparse rows
+struct NetworkBuildScratch {
+	std::vector<int> node_ids; // dense index -> id (sorted)
+	std::vector<int> out_starts; // forward edges of dense node i are [out_starts[i], out_starts[i + 1])
+	std::vector<int> out_targets;
+	std::vector<float> out_weights;
+	std::vector<int> in_degree; // forward edges into each node that haven't been sorted yet
+	std::vector<int> sorted_nodes; // topological order
+	std::vector<int> depths;
+	std::vector<int> depth_starts; // for the counting sort by (depth, id)
+	std::vector<int> internal_index; // dense index -> internal index (-1 if the node didn't get sorted)
+	std::vector<int> dense_index; // internal index -> dense index
+	std::vector<int> edge_starts; // same layout as Genome::Network::edge_starts and edge_sources (copied over unless the network is lean)
+	std::vector<int> edge_sources;
+	std::vector<int> edge_fill; // next free edge of each internal node
+};
+static thread_local NetworkBuildScratch build_scratch;
+
+void Genome::Network::Build(int input_nodes, int output_nodes, const std::vector<Gene>& genes, bool lean) {
+	num_input_nodes = input_nodes;
+	num_output_nodes = output_nodes;
+	NetworkBuildScratch& s = build_scratch;
 
-	// topological sort
-	std::vector<int> sortedNodes;
+	// dense indices for the inputs, the outputs and the ends of every enabled forward gene
+	const auto recurrentBegin = std::partition_point(genes.begin(), genes.end(), [](const Gene& e) { return !e.recurrent; });
+	s.node_ids.clear();
+	for (int i = 0; i < (input_nodes + output_nodes); ++i) {
+		s.node_ids.emplace_back(i);
+	}
+	for (auto it = genes.begin(); it != recurrentBegin; ++it) {
+		if (!it->enabled) continue;
+		if (IsOutputNode(it->from) && !IsOutputNode(it->to)) {
+			std::cerr << "Found output to non-output edge that isn't labelled as recurrent!" << std::endl;
+			return;
+		}
+		s.node_ids.emplace_back(it->from);
+		s.node_ids.emplace_back(it->to);
+	}
+	std::sort(s.node_ids.begin(), s.node_ids.end());
+	s.node_ids.erase(std::unique(s.node_ids.begin(), s.node_ids.end()), s.node_ids.end());
+	const int numNodes = s.node_ids.size();
+	auto denseIndex = [&](int id) { // -1 if not found
+		auto it = std::lower_bound(s.node_ids.begin(), s.node_ids.end(), id);
+		return (it == s.node_ids.end() || *it != id) ? -1 : (int)(it - s.node_ids.begin());
+	};
+
+	// forward genes are sorted by (from, to), so their rows come out in order
+	s.out_starts.assign(numNodes + 1, 0);
+	s.out_targets.clear();
+	s.out_weights.clear();
+	s.in_degree.assign(numNodes, 0);
+	for (auto it = genes.begin(); it != recurrentBegin; ++it) {
+		if (!it->enabled) continue;
+		const int to = denseIndex(it->to);
+		++s.out_starts[denseIndex(it->from) + 1];
+		s.out_targets.emplace_back(to);
+		s.out_weights.emplace_back(it->weight);
+		++s.in_degree[to];
+	}
+	for (int i = 0; i < numNodes; ++i) {
+		s.out_starts[i + 1] += s.out_starts[i];
+	}
+
+	// topological sort (the ids below input_nodes + output_nodes are their own dense indices)
+	s.sorted_nodes.clear();
 	for (int i = 0; i < input_nodes; ++i) { // add input nodes first (always a source)
-		sortedNodes.emplace_back(i);
+		s.sorted_nodes.emplace_back(i);
 	}
-	for (auto& e : adjacency_list_rev) {
-		if (IsInputNode(e.first)) continue; // input nodes already added (always added first)
-		if (IsOutputNode(e.first)) continue; // output nodes handled later
-		if (e.second.size() == 0) sortedNodes.emplace_back(e.first); // found a source node
+	for (int i = input_nodes + output_nodes; i < numNodes; ++i) { // hidden source nodes (outputs are handled later)
+		if (s.in_degree[i] == 0) s.sorted_nodes.emplace_back(i);
 	}
 	int sortedNodesIndex = 0;
-	for (; sortedNodesIndex < sortedNodes.size(); ++sortedNodesIndex) {
-		int curNode = sortedNodes[sortedNodesIndex];
-		for (auto& e : adjacency_list[curNode]) {
-			adjacency_list_rev[e].erase(curNode);
-			if (adjacency_list_rev[e].size() <= 0 && !IsOutputNode(e))
-				sortedNodes.emplace_back(e);
+	for (; sortedNodesIndex < s.sorted_nodes.size(); ++sortedNodesIndex) {
+		const int curNode = s.sorted_nodes[sortedNodesIndex];
+		for (int j = s.out_starts[curNode]; j < s.out_starts[curNode + 1]; ++j) {
+			const int next = s.out_targets[j];
+			if (--s.in_degree[next] <= 0 && !IsOutputNode(s.node_ids[next])) s.sorted_nodes.emplace_back(next);
 		}
 	}
 
 	// now topological sort the outputs
-	for (int i = 0; i < output_nodes; ++i) { // add output source nodes
-		int curNode = input_nodes + i;
-		if (adjacency_list_rev[curNode].size() <= 0) sortedNodes.emplace_back(curNode); // found output source node
+	for (int i = input_nodes; i < (input_nodes + output_nodes); ++i) { // add output source nodes
+		if (s.in_degree[i] <= 0) s.sorted_nodes.emplace_back(i);
 	}
-	for (; sortedNodesIndex < sortedNodes.size(); ++sortedNodesIndex) {
-		int curNode = sortedNodes[sortedNodesIndex];
-		if (!IsOutputNode(curNode)) { // sanity check
+	for (; sortedNodesIndex < s.sorted_nodes.size(); ++sortedNodesIndex) {
+		const int curNode = s.sorted_nodes[sortedNodesIndex];
+		if (!IsOutputNode(s.node_ids[curNode])) { // sanity check
 			std::cerr << "Expected an output node!" << std::endl; // failed to label output to non-output node as recurrent
 			return;
 		}
-		for (auto& e : adjacency_list[curNode]) {
-			adjacency_list_rev[e].erase(curNode);
-			if (adjacency_list_rev[e].size() <= 0) {
-				sortedNodes.emplace_back(e);
-			}
+		for (int j = s.out_starts[curNode]; j < s.out_starts[curNode + 1]; ++j) {
+			const int next = s.out_targets[j];
+			if (--s.in_degree[next] <= 0) s.sorted_nodes.emplace_back(next);
 		}
 	}
 
-	// calculate max depth
-	std::map<int, int> maxDepth;
+	// calculate max depth (pushed along the edges; every input of a node is sorted before it)
+	s.depths.assign(numNodes, 1);
 	int outputDepth = 0;
-	for (int i = 0; i < sortedNodes.size(); ++i) {
-		int curNode = sortedNodes[i];
-		if (IsInputNode(curNode)) {
-			maxDepth[curNode] = 0; // input is given maxDepth of 0
-			continue;
-		}
-
-		int curMaxDepth = 1;
-		if (IsOutputNode(curNode)) curMaxDepth = outputDepth + 1;
-		for (auto& e : adjacency_list_rev_copy[curNode]) {
-			const int newDepth = maxDepth[e] + 1;
-			if (newDepth > curMaxDepth) curMaxDepth = newDepth;
+	int maxDepth = 0;
+	for (int curNode : s.sorted_nodes) {
+		const int id = s.node_ids[curNode];
+		int& depth = s.depths[curNode];
+		if (IsInputNode(id)) depth = 0; // input is given maxDepth of 0
+		else if (IsOutputNode(id)) depth = std::max(depth, outputDepth + 1);
+		else outputDepth = std::max(outputDepth, depth);
+		maxDepth = std::max(maxDepth, depth);
+
+		for (int j = s.out_starts[curNode]; j < s.out_starts[curNode + 1]; ++j) {
+			s.depths[s.out_targets[j]] = std::max(s.depths[s.out_targets[j]], depth + 1);
 		}
-		maxDepth[curNode] = curMaxDepth;
-
-		if (!IsOutputNode(curNode) && (curMaxDepth > outputDepth)) outputDepth = curMaxDepth;
 	}
 
-	std::vector<NeuronIdDepth> id_depth_pair;
-	id_depth_pair.reserve(maxDepth.size());
-	for (auto& e : maxDepth) {
-		id_depth_pair.emplace_back(e.first, e.second);
-		//std::cout << e.first << ": " << e.second << std::endl;
+	// internal indices are sorted by (depth, id); dense indices are already in id order so a counting sort by depth does it
+	// (nodes that didn't get sorted are part of a cycle and get left out)
+	s.internal_index.assign(numNodes, -1);
+	for (int curNode : s.sorted_nodes) {
+		s.internal_index[curNode] = 0;
+	}
+	s.depth_starts.assign(maxDepth + 2, 0);
+	for (int i = 0; i < numNodes; ++i) {
+		if (s.internal_index[i] >= 0) ++s.depth_starts[s.depths[i] + 1];
+	}
+	for (int i = 0; i <= maxDepth; ++i) {
+		s.depth_starts[i + 1] += s.depth_starts[i];
+	}
+	const int numInternal = s.sorted_nodes.size();
+	s.dense_index.resize(numInternal);
+	for (int i = 0; i < numNodes; ++i) {
+		if (s.internal_index[i] < 0) continue;
+		s.internal_index[i] = s.depth_starts[s.depths[i]]++;
+		s.dense_index[s.internal_index[i]] = i;
 	}
-	sort(id_depth_pair.begin(), id_depth_pair.end());
-	/*for (auto& e : id_depth_pair) {
-		std::cout << e.first << ": " << e.second << std::endl;
-	}*/
 
 	// can now start flattening into internal indices
 
-	visual_info.reserve(id_depth_pair.size());
-
-	int last_depth = 0;
-	int curIndex = 0;
-	for (auto& e : id_depth_pair) {
-		if (e.depth != last_depth) {
-			layer_sizes.emplace_back(curIndex);
-			last_depth = e.depth;
-			curIndex = 0;
+	if (!lean) {
+		visual_info.reserve(numInternal);
+
+		int last_depth = 0;
+		int curIndex = 0;
+		for (int i = 0; i < numInternal; ++i) {
+			const int id = s.node_ids[s.dense_index[i]];
+			const int depth = s.depths[s.dense_index[i]];
+			if (depth != last_depth) {
+				layer_sizes.emplace_back(curIndex);
+				last_depth = depth;
+				curIndex = 0;
+			}
+			const bool bIsOutputNode = IsOutputNode(id);
+			visual_info.emplace_back(id, depth, bIsOutputNode ? (id - input_nodes) : curIndex, bIsOutputNode);
+			++curIndex;
 		}
-		const bool bIsOutputNode = IsOutputNode(e.id);
-		visual_info.emplace_back(e.id, e.depth, bIsOutputNode ? (e.id - input_nodes) : curIndex, bIsOutputNode);
-		++curIndex;
+		layer_sizes.emplace_back(curIndex);
 	}
-	layer_sizes.emplace_back(curIndex);
 
-	// mapping from label/id to internal index
-	std::map<int, int> internal_index_map;
-	for (int i = 0; i < id_depth_pair.size(); ++i) {
-		internal_index_map[id_depth_pair[i].id] = i;
+	std::vector<int> new_output_indices(num_output_nodes, 0);
+	for (int i = input_nodes; i < (input_nodes + output_nodes); ++i) {
+		new_output_indices[i - input_nodes] = s.internal_index[i];
 	}
 
-	// std::map<int,std::unordered_set<int>> adjacency_list_recurrent_rev; // now a member variable
-	for (auto& e : recurrent_edges) {
-		auto fromNode = std::get<0>(e.first);
-		auto toNode = std::get<1>(e.first);
-		adjacency_list_recurrent_rev[toNode].insert(fromNode);
-		adjacency_list_recurrent_rev[fromNode];
+	// count the edges into each node (recurrent genes whose ends aren't part of the network are left out)
+	std::vector<int> new_input_counts(numInternal, 0);
+	for (int i = 0; i < numNodes; ++i) {
+		if (s.internal_index[i] < 0) continue;
+		for (int j = s.out_starts[i]; j < s.out_starts[i + 1]; ++j) {
+			const int to = s.internal_index[s.out_targets[j]];
+			if (to >= 0) ++new_input_counts[to];
+		}
 	}
-
-	output_indices->reserve(num_output_nodes);
-	for (int i = 0; i < num_output_nodes; ++i) {
-		output_indices->emplace_back(0);
+	auto recurrentEnds = [&](const Gene& e, int& from_out, int& to_out) {
+		const int from = denseIndex(e.from);
+		const int to = denseIndex(e.to);
+		from_out = (from < 0) ? -1 : s.internal_index[from];
+		to_out = (to < 0) ? -1 : s.internal_index[to];
+		return from_out >= 0 && to_out >= 0;
+	};
+	for (auto it = recurrentBegin; it != genes.end(); ++it) {
+		int from;
+		int to;
+		if (it->enabled && recurrentEnds(*it, from, to)) ++new_input_counts[to];
 	}
 
-	run_info.reserve(id_depth_pair.size());
-	for (int i = 0; i < id_depth_pair.size(); ++i) {
-		int curNode = id_depth_pair[i].id;
-
-		if (IsOutputNode(curNode)) (*output_indices)[curNode - num_input_nodes] = i;
-
-		for (auto& f : adjacency_list_rev_copy[curNode]) {
-			auto edge_info = forward_edges.find({ f, curNode });
-			float weight = 0;
-			if (edge_info != forward_edges.end()) weight = (edge_info->second);
-			input_info->emplace_back(internal_index_map[f], weight);
+	// fill the forward edges of every node before the recurrent ones
+	s.edge_starts.assign(numInternal + 1, 0);
+	for (int i = 0; i < numInternal; ++i) {
+		s.edge_starts[i + 1] = s.edge_starts[i] + new_input_counts[i];
+	}
+	s.edge_fill.assign(s.edge_starts.begin(), s.edge_starts.end() - 1);
+	std::vector<NeuronInputInfo> new_input_info(s.edge_starts[numInternal]);
+	s.edge_sources.resize(s.edge_starts[numInternal]);
+	for (int i = 0; i < numNodes; ++i) {
+		const int from = s.internal_index[i];
+		if (from < 0) continue;
+		for (int j = s.out_starts[i]; j < s.out_starts[i + 1]; ++j) {
+			const int to = s.internal_index[s.out_targets[j]];
+			if (to < 0) continue;
+			s.edge_sources[s.edge_fill[to]] = from << 1;
+			new_input_info[s.edge_fill[to]++] = NeuronInputInfo(from, s.out_weights[j]);
 		}
-		for (auto& f : adjacency_list_recurrent_rev[curNode]) {
-			auto edge_info = recurrent_edges.find({ f, curNode });
-			float weight = 0;
-			if (edge_info != recurrent_edges.end()) weight = (edge_info->second);
-			input_info->emplace_back(internal_index_map[f], weight);
+	}
+	for (auto it = recurrentBegin; it != genes.end(); ++it) {
+		int from;
+		int to;
+		if (!it->enabled || !recurrentEnds(*it, from, to)) continue;
+		s.edge_sources[s.edge_fill[to]] = (from << 1) | 1;
+		new_input_info[s.edge_fill[to]++] = NeuronInputInfo(from, it->weight);
+	}
+	if (!lean) {
+		for (int i = 0; i < numInternal; ++i) {
+			std::sort(s.edge_sources.begin() + s.edge_starts[i], s.edge_sources.begin() + s.edge_starts[i + 1]);
 		}
-
-		int input_info_block_size = adjacency_list_rev_copy[curNode].size() + adjacency_list_recurrent_rev[curNode].size();
-		run_info.emplace_back((float)(0), input_info_block_size);
+		edge_starts = s.edge_starts;
+		edge_sources = s.edge_sources;
 	}
 
 	// set output of bias to 1
-	run_info[input_nodes - 1].output_val = 1;
+	node_vals.assign(numInternal, 0);
+	node_vals[input_nodes - 1] = 1;
 
-	/*
-	for (auto& e : adjacency_list) {
-		std::cout << e.first << std::endl;
-		std::cout << " IsOutput: " << IsOutputNode(e.first)
-			<< ", IsInput: " << IsInputNode(e.first) << std::endl;
+	std::vector<NEATActivation::Type> new_activations(numInternal, NEATActivation::Type::Tanh); // currently using tanh as the activation for all neurons
+	for (int i = 0; i < input_nodes; ++i) {
+		new_activations[i] = NEATActivation::Type::Identity;
 	}
 
-	std::cout << "forward edges" << std::endl;
-	for (auto &e : adjacency_list) {
-		std::cout << e.first << std::endl;
-		for (auto &f: e.second) {
-			std::cout << " " << f << std::endl;
-		}
-	}
-	std::cout << "reverse edges" << std::endl;
-	for (auto &e : adjacency_list_rev) {
-		std::cout << e.first << std::endl;
-		for (auto &f: e.second) {
-			std::cout << " " << f << std::endl;
-		}
-	}
-	*/
+	SortInputInfo(new_input_info, new_input_counts);
+	input_info = MakeSharedNetworkArray(std::move(new_input_info));
+	output_indices = MakeSharedNetworkArray(std::move(new_output_indices));
+	node_activations = MakeSharedNetworkArray(std::move(new_activations));
+	input_counts = MakeSharedNetworkArray(std::move(new_input_counts));
+	BuildBlocks();
 }
 
 /*
@@ -350,8 +803,8 @@ std::vector<std::tuple<const NeuronVisualInfo *, const NeuronVisualInfo *, float
 	std::vector<std::tuple<const NeuronVisualInfo *, const NeuronVisualInfo *, float>> ret_val;
 
 	int input_info_start_index = 0;
-	for (int i = 0; i < run_info.size(); ++i) {
-		const int numPrevNodes = run_info[i].input_info_block_size;
+	for (int i = 0; i < input_counts->size(); ++i) {
+		const int numPrevNodes = (*input_counts)[i];
 		if (numPrevNodes < 1) continue;
 
 		const NeuronInputInfo *prevInfo = &((*input_info)[input_info_start_index]);
@@ -377,78 +830,428 @@ int NetworkBase::GetNumOutputNodes() const {
 }
 
 void Genome::Network::PrintForwardEdges() const {
-	for (auto& e : adjacency_list) {
-		std::cout << e.first << std::endl;
-		for (auto& f : e.second) {
-			std::cout << " " << f << std::endl;
+	std::vector<std::pair<int, int>> edges; // (from, to) internal indices
+	for (int i = 0; i < (int)visual_info.size(); ++i) {
+		for (int j = edge_starts[i]; j < edge_starts[i + 1]; ++j) {
+			if ((edge_sources[j] & 1) == 0) edges.emplace_back(edge_sources[j] >> 1, i);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	auto it = edges.begin();
+	for (int i = 0; i < (int)visual_info.size(); ++i) {
+		std::cout << visual_info[i].label << std::endl;
+		for (; it != edges.end() && it->first == i; ++it) {
+			std::cout << " " << visual_info[it->second].label << std::endl;
 		}
 	}
 }
 
-bool Genome::Network::CheckRecurrent(int inputLabel, int outputLabel) const {
+void Genome::Network::BuildReachability() const {
+	std::vector<std::pair<int, int>> edges;
+	for (int i = 0; i < (int)visual_info.size(); ++i) {
+		for (int j = edge_starts[i]; j < edge_starts[i + 1]; ++j) {
+			if ((edge_sources[j] & 1) == 0) edges.emplace_back(edge_sources[j] >> 1, i);
+		}
+	}
+	reachability.Build(visual_info.size(), edges);
+	reachability_built = true;
+}
+
+bool Genome::Network::CheckRecurrent(int inputIndex, int outputIndex) const {
+	const int inputLabel = visual_info[inputIndex].label;
+	const int outputLabel = visual_info[outputIndex].label;
 	if (inputLabel == outputLabel) return true;
 	if (IsOutputNode(inputLabel) && !IsOutputNode(outputLabel)) return true;
 
-	// start at outputLabel and see if we can find inputLabel using BFS
-	std::unordered_set<int> discovered;
-	std::deque<int> frontier;
-	discovered.insert(outputLabel);
-	frontier.push_back(outputLabel);
-	while (frontier.size() > 0) {
-		int curNode = frontier.front();
-		frontier.pop_front();
+	if (!reachability_built) BuildReachability();
+	return reachability.CanReach(outputIndex, inputIndex); // the new edge closes a cycle if the output can already reach the input
+}
 
-		if (curNode == inputLabel) return true; // found input label
+bool Genome::Network::HasEdge(int inputIndex, int outputIndex) const {
+	auto begin = edge_sources.begin() + edge_starts[outputIndex];
+	auto end = edge_sources.begin() + edge_starts[outputIndex + 1];
+	auto it = std::lower_bound(begin, end, inputIndex << 1);
+	return it != end && (*it >> 1) == inputIndex;
+}
 
-		auto forwardEdgeLookup = adjacency_list.find(curNode);
-		if (forwardEdgeLookup == adjacency_list.end()) {
-			std::cerr << "Could not find node " << curNode << " in network" << std::endl;
-			return true;
+// same candidates as the random tries in FindNewPossibleConnection (any node to any node that isn't an input)
+bool Genome::Network::PickAbsentEdge(int& inputIndex_out, int& outputIndex_out) const {
+	const int numNodes = input_counts->size();
+	const int numTargets = numNodes - num_input_nodes;
+
+	// existing edges out of each node (a forward and a recurrent edge between the same nodes count once)
+	std::vector<int> numEdges(numNodes, 0);
+	for (int i = 0; i < numNodes; ++i) {
+		for (int j = edge_starts[i]; j < edge_starts[i + 1]; ++j) {
+			if (j > edge_starts[i] && (edge_sources[j] >> 1) == (edge_sources[j - 1] >> 1)) continue;
+			++numEdges[edge_sources[j] >> 1];
 		}
+	}
 
-		for (auto& e : forwardEdgeLookup->second) {
-			if (discovered.count(e) < 1) {
-				discovered.insert(e);
-				frontier.push_back(e);
-			}
+	int numAbsent = 0;
+	for (int i = 0; i < numNodes; ++i) {
+		numAbsent += numTargets - numEdges[i];
+	}
+	if (numAbsent <= 0) return false; // every edge exists
+
+	// find the node the edge starts from, and then which of its absent edges it is
+	int pick = NEATMathHelpers::rand_int(numAbsent - 1);
+	for (int i = 0; i < numNodes; ++i) {
+		const int nodeAbsent = numTargets - numEdges[i];
+		if (pick >= nodeAbsent) {
+			pick -= nodeAbsent;
+			continue;
+		}
+
+		for (int j = num_input_nodes; j < numNodes; ++j) {
+			if (HasEdge(i, j)) continue;
+			if (pick-- > 0) continue;
+			inputIndex_out = i;
+			outputIndex_out = j;
+			return true;
 		}
 	}
 
+	std::cerr << "PickAbsentEdge could not find the edge it picked" << std::endl;
 	return false;
 }
 
 bool Genome::Network::FindNewPossibleConnection(int& in, int& out, bool& is_recurrent, int max_tries) const {
+	int inputIndex = -1;
+	int outputIndex = -1;
 	for (int try_num = 0; try_num < max_tries; ++try_num) {
-		int randInput = NEATMathHelpers::rand_int(run_info.size() - 1); // can be any node
-		int randInputLabel = visual_info[randInput].label;
-		int randOutput = NEATMathHelpers::rand_int(num_input_nodes, run_info.size() - 1); // any node that isn't an input (or bias)
-		int randOutputLabel = visual_info[randOutput].label;
+		int randInput = NEATMathHelpers::rand_int(input_counts->size() - 1); // can be any node
+		int randOutput = NEATMathHelpers::rand_int(num_input_nodes, input_counts->size() - 1); // any node that isn't an input (or bias)
 
 		// check if connection already exists (check normal and recurrent connections)
-		auto forwardEdgeLookup = adjacency_list.find(randInputLabel);
-		if (forwardEdgeLookup == adjacency_list.end()) {
-			std::cerr << "Could not find node " << randInputLabel << std::endl;
+		if (HasEdge(randInput, randOutput)) continue;
+
+		inputIndex = randInput;
+		outputIndex = randOutput;
+		break;
+	}
+
+	// every try hit an existing edge (likely in dense networks), so draw from the absent edges directly
+	// (a try that succeeds is also uniform over the absent edges, so this doesn't change which edges get picked)
+	if (inputIndex < 0 && !PickAbsentEdge(inputIndex, outputIndex)) return false;
+
+	in = visual_info[inputIndex].label;
+	out = visual_info[outputIndex].label;
+	is_recurrent = CheckRecurrent(inputIndex, outputIndex);
+	return true;
+}
+
+void NetworkBase::ResetRecurrentConnections() {
+	node_vals.assign(input_counts->size(), 0); // resets all neuron outputs to 0
+	batch_lanes = 0; // lanes get cleared on the next call to RunBatch
+}
+
+void NetworkBase::SetActivation(NEATActivation::Type hidden, NEATActivation::Type output) {
+	std::vector<NEATActivation::Type> new_activations(node_activations->begin(), node_activations->end()); // copy so that other networks don't get modified
+	for (int i = num_input_nodes; i < (int)new_activations.size(); ++i) {
+		new_activations[i] = hidden;
+	}
+	for (auto& e : *output_indices) {
+		new_activations[e] = output;
+	}
+	node_activations = MakeSharedNetworkArray(std::move(new_activations));
+	BuildBlocks();
+}
+
+bool NetworkBase::SetNodeActivation(int node_index, NEATActivation::Type type) {
+	if (IsInputNode(node_index) || node_index >= (int)input_counts->size()) {
+		std::cerr << "SetNodeActivation failed since node " << node_index << " isn't a hidden or output node" << std::endl;
+		return false;
+	}
+	if ((*node_activations)[node_index] == type) return true;
+
+	std::vector<NEATActivation::Type> new_activations(node_activations->begin(), node_activations->end()); // copy so that other networks don't get modified
+	new_activations[node_index] = type;
+	node_activations = MakeSharedNetworkArray(std::move(new_activations));
+	BuildBlocks();
+	return true;
+}
+
+NEATActivation::Type NetworkBase::GetNodeActivation(int node_index) const {
+	return (*node_activations)[node_index];
+}
+
+int NetworkBase::GetNumBlocks() const {
+	return block_info->size();
+}
+
+int NetworkBase::GetNumDenseBlocks() const {
+	int numDense = 0;
+	for (auto& e : *block_info) {
+		if (e.is_dense) ++numDense;
+	}
+	return numDense;
+}
+
+void NetworkBase::SortInputInfo(std::vector<NeuronInputInfo>& edges, const std::vector<int>& counts) {
+	int input_info_start_index = 0;
+	for (auto& e : counts) {
+		NeuronInputInfo* prevInfo = edges.data() + input_info_start_index;
+		std::sort(prevInfo, prevInfo + e, [](const NeuronInputInfo& a, const NeuronInputInfo& b) {
+			return a.input_index < b.input_index;
+		});
+		input_info_start_index += e;
+	}
+}
+
+void NetworkBase::BuildDenseBlock(NeuronBlockInfo& block, std::vector<int>& new_dense_sources, std::vector<float>& new_dense_weights) {
+	// measure the density of the block
+	std::vector<int> sources;
+	const NeuronInputInfo* blockInfo = input_info->data() + block.input_info_start_index;
+	int numEdges = 0;
+	for (int k = 0; k < block.size; ++k) {
+		numEdges += (*input_counts)[block.start_index + k];
+	}
+	sources.reserve(numEdges);
+	for (int j = 0; j < numEdges; ++j) {
+		sources.emplace_back(blockInfo[j].input_index);
+	}
+	std::sort(sources.begin(), sources.end());
+	sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+	const int numWeights = block.size * sources.size();
+	if (numWeights < DENSE_BLOCK_MIN_WEIGHTS || numEdges < DENSE_BLOCK_MIN_DENSITY * numWeights) return; // stays sparse
+
+	// the dense kernel has to give the same sums as the sparse ones, so the block stays sparse if
+	// - a node reads the same source twice (the sparse kernels add both products, which rounds differently than adding the weights)
+	// - a node doesn't read a source that can be inf (the 0 weight of the missing edge would turn it into NaN)
+	std::vector<int> cols(numEdges);
+	std::vector<int> numReaders(sources.size(), 0);
+	int edgeIndex = 0;
+	for (int k = 0; k < block.size; ++k) {
+		const int numPrevNodes = (*input_counts)[block.start_index + k];
+		for (int j = 0; j < numPrevNodes; ++j, ++edgeIndex) {
+			cols[edgeIndex] = std::lower_bound(sources.begin(), sources.end(), blockInfo[edgeIndex].input_index) - sources.begin();
+			if (j > 0 && cols[edgeIndex] == cols[edgeIndex - 1]) return; // (edges are sorted by source)
+			++numReaders[cols[edgeIndex]];
+		}
+	}
+	for (int c = 0; c < (int)sources.size(); ++c) {
+		const bool isBounded = sources[c] == num_input_nodes - 1 || (!IsInputNode(sources[c]) && NEATActivation::IsBounded((*node_activations)[sources[c]])); // (the bias is always 1)
+		if (numReaders[c] < block.size && !isBounded) return;
+	}
+
+	block.is_dense = true;
+	block.num_sources = sources.size();
+	block.dense_source_start_index = new_dense_sources.size();
+	block.dense_weight_start_index = new_dense_weights.size();
+	new_dense_sources.insert(new_dense_sources.end(), sources.begin(), sources.end());
+	new_dense_weights.resize(new_dense_weights.size() + numWeights, 0);
+
+	float* weights = new_dense_weights.data() + block.dense_weight_start_index;
+	edgeIndex = 0;
+	for (int k = 0; k < block.size; ++k) {
+		const int numPrevNodes = (*input_counts)[block.start_index + k];
+		for (int j = 0; j < numPrevNodes; ++j, ++edgeIndex) {
+			weights[(size_t)cols[edgeIndex] * block.size + k] = GetRunWeight(block.input_info_start_index + edgeIndex);
+		}
+	}
+}
+
+float NetworkBase::GetRunWeight(int input_info_index) const {
+	if (packed_topology && half_precision_weights) return NEATMathHelpers::HalfToFloat(packed_topology->half_weights[input_info_index]);
+	return (*input_info)[input_info_index].weight;
+}
+
+bool NetworkBase::IsPacked() const {
+	return packed_topology != nullptr;
+}
+
+void NetworkBase::SetHalfPrecisionWeights(bool enabled) {
+	if (half_precision_weights == enabled) return;
+	half_precision_weights = enabled;
+	BuildBlocks();
+}
+
+void NetworkBase::BuildPackedTopology() {
+	packed_topology = nullptr;
+
+	const int numNodes = input_counts->size();
+	if (numNodes > 65535) return; // input counts (up to numNodes) and node indices have to fit in 16 bits
+
+	auto packed = std::make_shared<PackedTopology>();
+	packed->input_counts = NetworkArray<unsigned short>(std::vector<unsigned short>(input_counts->begin(), input_counts->end()));
+	std::vector<unsigned short> indices;
+	indices.reserve(input_info->size());
+	for (auto& e : *input_info) {
+		indices.emplace_back((unsigned short)e.input_index);
+	}
+	packed->input_indices = NetworkArray<unsigned short>(std::move(indices));
+
+	if (half_precision_weights) {
+		std::vector<unsigned short> weights;
+		weights.reserve(input_info->size());
+		for (auto& e : *input_info) {
+			weights.emplace_back(NEATMathHelpers::FloatToHalf(e.weight));
+		}
+		packed->half_weights = NetworkArray<unsigned short>(std::move(weights));
+	}
+	else {
+		std::vector<float> weights;
+		weights.reserve(input_info->size());
+		for (auto& e : *input_info) {
+			weights.emplace_back(e.weight);
+		}
+		packed->weights = NetworkArray<float>(std::move(weights));
+	}
+
+	packed_topology = packed;
+}
+
+void NetworkBase::BuildBlocks() {
+	std::vector<NeuronBlockInfo> new_blocks;
+	std::vector<int> new_dense_sources;
+	std::vector<float> new_dense_weights;
+
+	BuildPackedTopology(); // has to be built first since the dense blocks use its (possibly half precision) weights
+
+	int input_info_start_index = 0;
+	for (int i = num_input_nodes; i < (int)input_counts->size(); ++i) {
+		const int numPrevNodes = (*input_counts)[i];
+		const NEATActivation::Type activation = (*node_activations)[i];
+
+		bool startNewBlock = new_blocks.empty() || new_blocks.back().activation != activation;
+		if (!startNewBlock) { // can't join the current block if it reads the output of a node that's in it (and hasn't been written yet)
+			const int blockStart = new_blocks.back().start_index;
+			for (int j = 0; j < numPrevNodes; ++j) {
+				const int prevIndex = (*input_info)[input_info_start_index + j].input_index;
+				if (prevIndex >= blockStart && prevIndex < i) {
+					startNewBlock = true;
+					break;
+				}
+			}
+		}
+
+		if (startNewBlock) new_blocks.emplace_back(i, input_info_start_index, activation);
+		++new_blocks.back().size;
+		input_info_start_index += numPrevNodes;
+	}
+
+	for (auto& block : new_blocks) {
+		BuildDenseBlock(block, new_dense_sources, new_dense_weights);
+	}
+
+	// new shared ptrs so that other networks don't get corrupted
+	block_info = MakeSharedNetworkArray(std::move(new_blocks));
+	dense_sources = MakeSharedNetworkArray(std::move(new_dense_sources));
+	dense_weights = MakeSharedNetworkArray(std::move(new_dense_weights));
+}
+
+static inline float PackedWeight(float weight) {
+	return weight;
+}
+
+static inline float PackedWeight(unsigned short weight) {
+	return NEATMathHelpers::HalfToFloat(weight);
+}
+
+// weighted sums of numNodes consecutive nodes stored in the packed layout (helper for NetworkBase::RunNodes)
+template<typename WeightType>
+static void SparseBlockSums(const float* vals, const unsigned short* counts, const unsigned short* prevIndices, const WeightType* prevWeights, int numNodes, float* sums) {
+	for (int k = 0; k < numNodes; ++k) {
+		const int numPrevNodes = counts[k];
+		float sum = 0;
+		for (int j = 0; j < numPrevNodes; ++j) {
+			sum += vals[prevIndices[j]] * PackedWeight(prevWeights[j]);
+		}
+		prevIndices += numPrevNodes;
+		prevWeights += numPrevNodes;
+		sums[k] = sum;
+	}
+}
+
+void NetworkBase::RunNodes() {
+	if (sums_scratch.size() < 2 * input_counts->size()) sums_scratch.resize(2 * input_counts->size()); // room for the sums and the gathered inputs of a block
+	RunNodes(node_vals.data(), sums_scratch.data());
+}
+
+void NetworkBase::RunNodes(float* vals, float* sums) const {
+	vals[num_input_nodes - 1] = 1; // bias always set to 1
+
+	for (auto& block : *block_info) {
+		if (block.is_dense) {
+			const int* sources = dense_sources->data() + block.dense_source_start_index;
+			float* gathered = sums + block.size;
+			for (int c = 0; c < block.num_sources; ++c) {
+				gathered[c] = vals[sources[c]];
+			}
+			NEATSIMD::DenseMatVec(dense_weights->data() + block.dense_weight_start_index, gathered, block.size, block.num_sources, sums);
+			NEATActivation::ApplyBlock(block.activation, sums, block.size);
+			for (int k = 0; k < block.size; ++k) {
+				vals[block.start_index + k] = sums[k];
+			}
 			continue;
 		}
-		if (forwardEdgeLookup->second.count(randOutputLabel) > 0) continue; // edge exists
 
-		auto recurrentEdgeLookup = adjacency_list_recurrent_rev.find(randOutputLabel);
-		if (recurrentEdgeLookup != adjacency_list_recurrent_rev.end()) {
-			if (recurrentEdgeLookup->second.count(randInputLabel) > 0) continue; // edge exists
+		if (packed_topology) {
+			const PackedTopology& packed = *packed_topology;
+			const unsigned short* counts = packed.input_counts.data() + block.start_index;
+			const unsigned short* prevIndices = packed.input_indices.data() + block.input_info_start_index;
+			if (half_precision_weights) {
+				SparseBlockSums(vals, counts, prevIndices, packed.half_weights.data() + block.input_info_start_index, block.size, sums);
+			}
+			else {
+				SparseBlockSums(vals, counts, prevIndices, packed.weights.data() + block.input_info_start_index, block.size, sums);
+			}
 		}
+		else {
+			const NeuronInputInfo* prevInfo = input_info->data() + block.input_info_start_index;
+			for (int k = 0; k < block.size; ++k) {
+				const int numPrevNodes = (*input_counts)[block.start_index + k];
+				float sum = 0;
+				for (int j = 0; j < numPrevNodes; ++j) {
+					sum += vals[prevInfo[j].input_index] * prevInfo[j].weight;
+				}
+				prevInfo += numPrevNodes;
+				sums[k] = sum;
+			}
+		}
+
+		NEATActivation::ApplyBlock(block.activation, sums, block.size);
 
-		in = randInputLabel;
-		out = randOutputLabel;
-		is_recurrent = CheckRecurrent(randInputLabel, randOutputLabel);
-		return true;
+		for (int k = 0; k < block.size; ++k) {
+			vals[block.start_index + k] = sums[k];
+		}
 	}
+}
 
-	return false;
+void NetworkBase::PrepareBatchLanes(int batch_size, bool keep_lane_state) {
+	if (!keep_lane_state || batch_size != batch_lanes) {
+		batch_vals.assign((size_t)input_counts->size() * batch_size, 0);
+		batch_lanes = batch_size;
+	}
+	if ((int)sums_scratch.size() < batch_size) sums_scratch.resize(batch_size);
+
+	float* bias = &batch_vals[(size_t)(num_input_nodes - 1) * batch_size];
+	std::fill(bias, bias + batch_size, 1.f); // bias always set to 1
 }
 
-void NetworkBase::ResetRecurrentConnections() {
-	for (auto& e : run_info) {
-		e.output_val = 0; // resets all neuron outputs to 0
+void NetworkBase::RunBatchLanes() {
+	const int batch_size = batch_lanes;
+	float* sums = &sums_scratch[0];
+
+	int input_info_index = 0;
+	for (int i = num_input_nodes; i < (int)input_counts->size(); ++i) {
+		const int numPrevNodes = (*input_counts)[i];
+		std::fill(sums, sums + batch_size, 0.f);
+
+		for (int j = 0; j < numPrevNodes; ++j, ++input_info_index) {
+			const float weight = GetRunWeight(input_info_index); // each weight gets loaded once and applied to every lane
+			const float* src = &batch_vals[(size_t)(*input_info)[input_info_index].input_index * batch_size];
+			for (int b = 0; b < batch_size; ++b) {
+				sums[b] += src[b] * weight;
+			}
+		}
+
+		NEATActivation::ApplyBlock((*node_activations)[i], sums, batch_size); // vectorized across lanes
+
+		std::copy(sums, sums + batch_size, &batch_vals[(size_t)i * batch_size]);
 	}
 }
 
@@ -470,8 +1273,8 @@ NetworkBaseVisual::iterator NetworkBaseVisual::iterator::end() const {
 
 void NetworkBaseVisual::iterator::validate_node() {
 	// find next node with an edge
-	for (; node_index < ptr->run_info.size(); ++node_index) {
-		const int numPrevNodes = ptr->run_info[node_index].input_info_block_size;
+	for (; node_index < (int)ptr->input_counts->size(); ++node_index) {
+		const int numPrevNodes = (*ptr->input_counts)[node_index];
 		if (numPrevNodes >= 1) return; // found node with an edge
 	}
 	isEnd = true; // no edges
@@ -480,7 +1283,7 @@ void NetworkBaseVisual::iterator::validate_node() {
 NetworkBaseVisual::iterator NetworkBaseVisual::iterator::operator++() {
 	if (isEnd) return *this;
 
-	const int numPrevNodes = ptr->run_info[node_index].input_info_block_size;
+	const int numPrevNodes = (*ptr->input_counts)[node_index];
 	++prev_index;
 	if (prev_index < numPrevNodes) return *this; // we're done
 
@@ -27,6 +27,47 @@
 #include <vector>
 #include <memory>
 #include <iostream>
+#include <cmath>
+#include "Activation.h"
+
+namespace NEATNetworkFile { class MappedFile; }
+
+// immutable array shared between copies of a network
+// either owns its elements or points into a memory mapped network file (which it keeps alive)
+template<typename T>
+class NetworkArray {
+public:
+	NetworkArray() {}
+	NetworkArray(std::vector<T>&& argVals) : vals{ std::move(argVals) }, ptr{ vals.data() }, count{ vals.size() } {}
+	NetworkArray(const T* argPtr, size_t argCount, const std::shared_ptr<const NEATNetworkFile::MappedFile>& argMapping)
+		: ptr{ argPtr }, count{ argCount }, mapping{ argMapping } {}
+	NetworkArray(NetworkArray&& other) = default; // moving vals keeps its buffer, so ptr stays valid
+	NetworkArray& operator=(NetworkArray&& other) = default;
+	NetworkArray(const NetworkArray&) = delete;
+	NetworkArray& operator=(const NetworkArray&) = delete;
+
+	const T& operator[](size_t i) const { return ptr[i]; }
+	const T* data() const { return ptr; }
+	const T* begin() const { return ptr; }
+	const T* end() const { return ptr + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	bool IsMapped() const { return mapping != nullptr; }
+
+private:
+	std::vector<T> vals;
+	const T* ptr = nullptr;
+	size_t count = 0;
+	std::shared_ptr<const NEATNetworkFile::MappedFile> mapping;
+};
+
+template<typename T>
+using SharedNetworkArray = std::shared_ptr<const NetworkArray<T>>; // shared_ptr so that copied networks point to the same data
+
+template<typename T>
+SharedNetworkArray<T> MakeSharedNetworkArray(std::vector<T>&& vals) {
+	return std::make_shared<const NetworkArray<T>>(std::move(vals));
+}
 
 // struct for holding visualization information of a neuron
 struct NeuronVisualInfo {
@@ -41,6 +82,10 @@ struct NeuronVisualInfo {
 
 // lightweight network for processing information
 class NetworkBase {
+	friend class PopulationEvaluator; // packs networks into its own arenas
+	friend class QuantizedNetwork; // reads the weights and calibration outputs
+	friend class NetworkModel; // runs the shared data with external state
+	template<typename Weight, typename Value> friend class TypedNetwork; // converts the weights
 public:
 	NetworkBase();
 	NetworkBase(const char* fname);
@@ -53,6 +98,26 @@ public:
 	int GetNumNodes() const; // for debugging
 	int GetNumEdges() const; // for debugging
 	int GetNumOutputNodes() const; // for debugging and also used for visualization
+	int GetNumBlocks() const; // for debugging
+	int GetNumDenseBlocks() const; // for debugging
+	bool IsPacked() const; // for debugging (whether the compact 16-bit index layout is being used)
+
+	// stores the weights used by Run and RunBatch in half precision (halves the memory used by the weights again at the cost of precision)
+	// only has an effect if the network is packed, and doesn't affect networks this one was copied from
+	void SetHalfPrecisionWeights(bool enabled);
+
+	// activation functions are stored per node (hidden and output nodes default to tanh)
+	// setting an activation doesn't affect networks this one was copied from
+	void SetActivation(NEATActivation::Type hidden, NEATActivation::Type output); // sets the activation of every hidden and output node
+	bool SetNodeActivation(int node_index, NEATActivation::Type type); // node_index is the internal index (input nodes can't be changed)
+	NEATActivation::Type GetNodeActivation(int node_index) const;
+
+	// writes a self-contained C++ header with a struct named struct_name that evaluates this network without any allocations or indirection
+	// (every edge becomes a constant multiply-add, and only the nodes read by recurrent connections are kept as state)
+	// the generated code gives bit-identical results to Run as long as the compiler doesn't contract multiply-adds into FMAs
+	// (weights are written as hexadecimal float literals, so the generated header needs C++17)
+	// returns true on success and false on failure (defined in NetworkExport.cpp)
+	bool ExportHeader(const char* fname, const char* struct_name) const;
 
 protected:
 	struct NeuronInputInfo {
@@ -62,6 +127,7 @@ protected:
 		NeuronInputInfo() {}
 	};
 
+	// layout of a node in files saved in the original (version 1) layout
 	struct NeuronRunInfo {
 		float output_val = 0;
 		int input_info_block_size = 0;
@@ -76,12 +142,77 @@ protected:
 	bool IsOutputNode(int node_id) const;
 	bool IsInputNode(int node_id) const;
 
+	// files written by Save are memory mapped, and the network's arrays point straight into the mapping (see NetworkFile.h)
+	// files in the original headerless format are still read with LoadImpl
 	void Load(const char* fname);
 	virtual void LoadImpl(std::ifstream& file);
+	virtual bool LoadMappedImpl(const std::shared_ptr<const NEATNetworkFile::MappedFile>& mapping); // returns true on success
+
+	SharedNetworkArray<NeuronInputInfo> input_info;
+	SharedNetworkArray<int> output_indices;
+	SharedNetworkArray<NEATActivation::Type> node_activations; // activation of each node (input nodes use Identity)
+	SharedNetworkArray<int> input_counts; // number of edges (in input_info) feeding each node
+
+	std::vector<float> node_vals; // output of each node; this is the only per-instance state (also holds the recurrent state)
+
+	// consecutive non-input nodes that can be evaluated together
+	// none of the nodes in a block read the output of an earlier node in the same block (so nodes from the same layer end up together),
+	// which allows the activation to be applied to the whole block at once with the vector kernels
+	// each block picks its kernel when it's built: blocks whose nodes share most of their inputs are evaluated as a dense mat-vec,
+	// and the rest walk their edges in CSR layout (packed_topology if the network fits, otherwise input_info and input_counts)
+	// both kernels give bit-identical sums, so a block only becomes dense if it has no repeated edges and its missing edges
+	// only come from bounded nodes (the 0 weight of a missing edge would turn an inf from an unbounded node into NaN)
+	struct NeuronBlockInfo {
+		int start_index = 0;
+		int size = 0;
+		int input_info_start_index = 0;
+		NEATActivation::Type activation = NEATActivation::Type::Tanh;
+		bool is_dense = false;
+		int num_sources = 0; // distinct inputs of a dense block
+		int dense_source_start_index = 0; // index into dense_sources
+		int dense_weight_start_index = 0; // index into dense_weights (num_sources x size, column-major)
+		NeuronBlockInfo(int argStartIndex, int argInputInfoStartIndex, NEATActivation::Type argActivation)
+			: start_index{ argStartIndex }, input_info_start_index{ argInputInfoStartIndex }, activation{ argActivation } {}
+		NeuronBlockInfo() {}
+	};
+
+	SharedNetworkArray<NeuronBlockInfo> block_info;
+	SharedNetworkArray<int> dense_sources; // inputs of the dense blocks
+	SharedNetworkArray<float> dense_weights; // weight matrices of the dense blocks (missing edges are 0)
+
+	// sorts the edges of each node by input index so that the sparse and dense kernels sum in the same order
+	static void SortInputInfo(std::vector<NeuronInputInfo>& edges, const std::vector<int>& counts);
+	// compact copy of the edges that the sparse kernels read instead of input_info (halves the bytes per edge)
+	// only used if every node index fits in 16 bits
+	struct PackedTopology {
+		NetworkArray<unsigned short> input_counts;
+		NetworkArray<unsigned short> input_indices;
+		NetworkArray<float> weights; // empty when using half precision weights
+		NetworkArray<unsigned short> half_weights;
+	};
 
-	std::shared_ptr<std::vector<NeuronInputInfo>> input_info; // shared_ptr so that copied networks point to the same weights vector
-	std::shared_ptr<std::vector<int>> output_indices;
-	std::vector<NeuronRunInfo> run_info;
+	std::shared_ptr<PackedTopology> packed_topology; // nullptr if the network doesn't fit
+	bool half_precision_weights = false;
+
+	void BuildPackedTopology(); // helper for BuildBlocks
+	float GetRunWeight(int input_info_index) const; // weight of an edge as seen by Run (i.e. rounded when using half precision weights)
+	void BuildBlocks(); // has to be called whenever input_counts, input_info or node_activations change
+	// helper for BuildBlocks; makes the block dense if enough of its weights are non-zero (and the dense kernel gives the same sums)
+	void BuildDenseBlock(NeuronBlockInfo& block, std::vector<int>& new_dense_sources, std::vector<float>& new_dense_weights);
+
+	std::vector<float> sums_scratch; // weighted sums of the current block (Run) or of the current node for every lane (RunBatch)
+
+	void RunNodes(); // helper for Run; evaluates every non-input node (inputs should already be set)
+	// evaluates every non-input node of vals (only reads the shared data, so it can be called from many threads with different buffers)
+	// sums needs room for 2 * GetNumNodes() floats
+	void RunNodes(float* vals, float* sums) const;
+
+	// structure-of-arrays node outputs used by RunBatch (node i occupies lanes [i * batch_lanes, (i + 1) * batch_lanes))
+	std::vector<float> batch_vals;
+	int batch_lanes = 0;
+
+	void PrepareBatchLanes(int batch_size, bool keep_lane_state); // helper for RunBatch
+	void RunBatchLanes(); // helper for RunBatch; evaluates every non-input node for all lanes
 
 public:
 	template<typename T, typename U>
@@ -102,28 +233,61 @@ public:
 		}
 
 		for (int i = 0; i < (num_input_nodes - 1); ++i) {
-			run_info[i].output_val = in[i];
+			node_vals[i] = in[i];
 		}
 
-		run_info[num_input_nodes - 1].output_val = 1; // bias always set to 1
+		RunNodes();
 
-		int input_info_start_index = 0;
-		for (int i = num_input_nodes; i < run_info.size(); ++i) {
-			const int numPrevNodes = run_info[i].input_info_block_size;
-			float sum = 0;
-			if (numPrevNodes > 0) {
-				const NeuronInputInfo* prevInfo = &((*input_info)[input_info_start_index]);
-
-				for (int j = 0; j < numPrevNodes; ++j) {
-					sum += run_info[prevInfo[j].input_index].output_val * prevInfo[j].weight;
-				}
-				input_info_start_index += numPrevNodes;
+		for (int i = 0; i < num_output_nodes; ++i) {
+			out[i] = node_vals[(*output_indices)[i]];
+		}
+
+		return true;
+	}
+
+	// runs batch_size independent samples in a single pass over the edges
+	// in is a row-major (batch_size x input size) matrix and out is a row-major (batch_size x output size) matrix
+	// if keep_lane_state is true, each row keeps its own recurrent state between calls (cleared by ResetRecurrentConnections or a change in batch_size)
+	// otherwise every row is evaluated from a reset state
+	template<typename T, typename U>
+	bool RunBatch(const std::vector<T>& in, std::vector<U>& out, int batch_size, bool keep_lane_state = false) {
+		if (IsInvalid()) {
+			std::cerr << "RunBatch failed since NetworkBase is corrupted or hasn't been initialized" << std::endl;
+			return false;
+		}
+
+		if (batch_size < 1) {
+			std::cerr << "NetworkBase::RunBatch received invalid batch size" << std::endl;
+			return false;
+		}
+
+		const int num_inputs = num_input_nodes - 1;
+		if (in.size() != (size_t)batch_size * num_inputs) {
+			std::cerr << "NetworkBase::RunBatch received input matrix with incorrect size" << std::endl;
+			return false;
+		}
+
+		if (out.size() != (size_t)batch_size * num_output_nodes) {
+			std::cerr << "NetworkBase::RunBatch received output matrix with incorrect size" << std::endl;
+			return false;
+		}
+
+		PrepareBatchLanes(batch_size, keep_lane_state);
+
+		for (int i = 0; i < num_inputs; ++i) { // transpose inputs into lanes
+			float* lanes = &batch_vals[(size_t)i * batch_size];
+			for (int b = 0; b < batch_size; ++b) {
+				lanes[b] = in[(size_t)b * num_inputs + i];
 			}
-			run_info[i].output_val = tanh(sum); // currently hardcoding tanh as activation for all neurons
 		}
 
-		for (int i = 0; i < num_output_nodes; ++i) {
-			out[i] = run_info[(*output_indices)[i]].output_val;
+		RunBatchLanes();
+
+		for (int i = 0; i < num_output_nodes; ++i) { // transpose lanes back into rows
+			const float* lanes = &batch_vals[(size_t)(*output_indices)[i] * batch_size];
+			for (int b = 0; b < batch_size; ++b) {
+				out[(size_t)b * num_output_nodes + i] = lanes[b];
+			}
 		}
 
 		return true;
@@ -163,6 +327,7 @@ public:
 
 protected:
 	virtual void LoadImpl(std::ifstream& file) override;
+	virtual bool LoadMappedImpl(const std::shared_ptr<const NEATNetworkFile::MappedFile>& mapping) override;
 
 	std::vector<NeuronVisualInfo> visual_info; // contains labels which is used for visualization as well as finding possible connections for NEAT
 	std::vector<int> layer_sizes;
@@ -0,0 +1,166 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "Network.h"
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <locale>
+#include <string>
+
+// float literal that reads back as exactly the same value
+// finite values are written as hexadecimal literals built from the bits (so they're exact and don't depend on the locale's decimal point),
+// and inf and NaN as std::numeric_limits expressions since they don't have literals
+static std::string FloatLiteral(float val) {
+	if (std::isnan(val)) return "std::numeric_limits<float>::quiet_NaN()";
+	if (std::isinf(val)) return (val > 0) ? "std::numeric_limits<float>::infinity()" : "-std::numeric_limits<float>::infinity()";
+
+	uint32_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	const char* sign = (bits >> 31) ? "-" : "";
+	const int exponent = (bits >> 23) & 0xff;
+	const unsigned int mantissa = (bits & 0x7fffff) << 1; // 24 bits, so it's exactly 6 hex digits
+	char buf[32];
+	if (exponent == 0) snprintf(buf, sizeof(buf), "%s0x0.%06xp-126f", sign, mantissa); // zero or subnormal
+	else snprintf(buf, sizeof(buf), "%s0x1.%06xp%+df", sign, mantissa, exponent - 127);
+	return buf;
+}
+
+static bool IsValidIdentifier(const char* name) {
+	if (name == nullptr || !(isalpha((unsigned char)name[0]) || name[0] == '_')) return false;
+	for (const char* c = name; *c != '\0'; ++c) {
+		if (!(isalnum((unsigned char)*c) || *c == '_')) return false;
+	}
+	return true;
+}
+
+// expression applying the activation to the sum named sumName (mirrors NEATActivation::Apply)
+static std::string ActivationExpression(NEATActivation::Type type, const std::string& sumName) {
+	switch (type) {
+	case NEATActivation::Type::Tanh: return "std::tanh(" + sumName + ")";
+	case NEATActivation::Type::FastTanh: return "FastTanh(" + sumName + ")";
+	case NEATActivation::Type::Sigmoid: return "1.f / (1.f + std::exp(-" + sumName + "))";
+	case NEATActivation::Type::ReLU: return "((" + sumName + " > 0) ? " + sumName + " : 0.f)";
+	case NEATActivation::Type::ClampedLinear: return "Clamp(" + sumName + ", -1.f, 1.f)";
+	default: return sumName; // Identity
+	}
+}
+
+bool NetworkBase::ExportHeader(const char* fname, const char* struct_name) const {
+	if (IsInvalid()) {
+		std::cerr << "ExportHeader failed since NetworkBase is corrupted or hasn't been initialized" << std::endl;
+		return false;
+	}
+
+	if (!IsValidIdentifier(struct_name)) {
+		std::cerr << "ExportHeader failed since " << (struct_name ? struct_name : "(null)") << " isn't a valid struct name" << std::endl;
+		return false;
+	}
+
+	const int numNodes = input_counts->size();
+
+	// nodes that get read before they're written during a run (i.e. by recurrent connections) have to keep their value between runs
+	std::vector<int> stateIndex(numNodes, -1);
+	int numStateNodes = 0;
+	int input_info_start_index = 0;
+	for (int i = 0; i < numNodes; ++i) {
+		const int numPrevNodes = (*input_counts)[i];
+		for (int j = 0; j < numPrevNodes; ++j) {
+			const int prevIndex = (*input_info)[input_info_start_index + j].input_index;
+			if (prevIndex >= i && stateIndex[prevIndex] < 0) stateIndex[prevIndex] = numStateNodes++;
+		}
+		input_info_start_index += numPrevNodes;
+	}
+
+	auto nodeName = [&](int node_index) -> std::string {
+		if (stateIndex[node_index] >= 0) return "state[" + std::to_string(stateIndex[node_index]) + "]";
+		return "n" + std::to_string(node_index);
+	};
+
+	std::ofstream file{ fname, std::ofstream::out | std::ofstream::trunc };
+	if (!file.is_open()) {
+		std::cerr << "Failed to open " << fname << std::endl;
+		return false;
+	}
+	file.imbue(std::locale::classic()); // (a global locale could group the digits of the sizes and indices)
+
+	const int numInputs = num_input_nodes - 1;
+
+	file << "// generated by NetworkBase::ExportHeader (" << numNodes << " nodes, " << input_info->size() << " edges); do not edit\n";
+	file << "#pragma once\n\n";
+	file << "#include <cmath>\n";
+	file << "#include <limits>\n\n";
+	file << "struct " << struct_name << " {\n";
+	file << "\tstatic const int num_inputs = " << numInputs << ";\n";
+	file << "\tstatic const int num_outputs = " << num_output_nodes << ";\n";
+	file << "\tstatic const int num_state = " << numStateNodes << ";\n\n";
+	file << "\tfloat state[" << (numStateNodes > 0 ? numStateNodes : 1) << "] = {}; // outputs of the nodes read by recurrent connections\n\n";
+	file << "\tvoid ResetRecurrentConnections() {\n";
+	file << "\t\tfor (auto& e : state) e = 0;\n";
+	file << "\t}\n\n";
+	file << "\tstatic float Clamp(float val, float min_val, float max_val) {\n";
+	file << "\t\tif (val < min_val) return min_val;\n";
+	file << "\t\tif (val > max_val) return max_val;\n";
+	file << "\t\treturn val;\n";
+	file << "\t}\n\n";
+	file << "\tstatic float FastTanh(float val) {\n";
+	file << "\t\tconst float x = Clamp(val, -4.97f, 4.97f);\n";
+	file << "\t\tconst float x2 = x * x;\n";
+	file << "\t\tconst float p = x * (135135.f + x2 * (17325.f + x2 * (378.f + x2)));\n";
+	file << "\t\tconst float q = 135135.f + x2 * (62370.f + x2 * (3150.f + x2 * 28.f));\n";
+	file << "\t\treturn Clamp(p / q, -1.f, 1.f);\n";
+	file << "\t}\n\n";
+	file << "\tvoid Run(const float (&in)[" << numInputs << "], float (&out)[" << num_output_nodes << "]) {\n";
+
+	for (int i = 0; i < numInputs; ++i) {
+		file << "\t\tconst float " << nodeName(i) << " = in[" << i << "];\n";
+	}
+	file << "\t\tconst float " << nodeName(numInputs) << " = 1.f; // bias\n";
+
+	input_info_start_index = 0;
+	for (int i = num_input_nodes; i < numNodes; ++i) {
+		const int numPrevNodes = (*input_counts)[i];
+		const std::string sumName = "s" + std::to_string(i);
+		file << "\t\tfloat " << sumName << " = 0;\n";
+		for (int j = 0; j < numPrevNodes; ++j) {
+			const NeuronInputInfo& prevInfo = (*input_info)[input_info_start_index + j];
+			file << "\t\t" << sumName << " += " << nodeName(prevInfo.input_index) << " * " << FloatLiteral(GetRunWeight(input_info_start_index + j)) << ";\n"; // (same weight as Run)
+		}
+		input_info_start_index += numPrevNodes;
+
+		if (stateIndex[i] >= 0) file << "\t\t" << nodeName(i) << " = " << ActivationExpression((*node_activations)[i], sumName) << ";\n";
+		else file << "\t\tconst float " << nodeName(i) << " = " << ActivationExpression((*node_activations)[i], sumName) << ";\n";
+	}
+
+	for (int i = 0; i < num_output_nodes; ++i) {
+		file << "\t\tout[" << i << "] = " << nodeName((*output_indices)[i]) << ";\n";
+	}
+	file << "\t}\n";
+	file << "};\n";
+
+	file.close();
+	return true;
+}
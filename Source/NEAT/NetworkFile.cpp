@@ -0,0 +1,194 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "NetworkFile.h"
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+uint64_t NEATNetworkFile::Checksum(const unsigned char* data, size_t size, uint64_t hash) {
+	// one 64-bit word at a time (the shift folds the high bits back down since the multiply only carries upwards)
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+		hash ^= hash >> 32;
+	}
+	for (; i < size; ++i) {
+		hash = (hash ^ data[i]) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static uint64_t FileChecksum(const NEATNetworkFile::Header& header, const unsigned char* data, size_t size) {
+	NEATNetworkFile::Header zeroed = header;
+	zeroed.checksum = 0;
+	const uint64_t hash = NEATNetworkFile::Checksum((const unsigned char*)&zeroed, sizeof(zeroed));
+	return NEATNetworkFile::Checksum(data + sizeof(zeroed), size - sizeof(zeroed), hash);
+}
+
+std::shared_ptr<const NEATNetworkFile::MappedFile> NEATNetworkFile::MappedFile::Open(const char* fname) {
+	std::shared_ptr<MappedFile> mapping(new MappedFile());
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return nullptr;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0) {
+		CloseHandle(file);
+		return nullptr;
+	}
+	HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (fileMapping == nullptr) return nullptr;
+	void* view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(fileMapping); // the view keeps the mapping alive
+	if (view == nullptr) return nullptr;
+	mapping->data = (const unsigned char*)view;
+	mapping->size = (size_t)fileSize.QuadPart;
+#else
+	const int fd = open(fname, O_RDONLY);
+	if (fd < 0) return nullptr;
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+		close(fd);
+		return nullptr;
+	}
+	void* view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping stays valid after closing the file
+	if (view == MAP_FAILED) return nullptr;
+	mapping->data = (const unsigned char*)view;
+	mapping->size = (size_t)fileStat.st_size;
+#endif
+	return mapping;
+}
+
+NEATNetworkFile::MappedFile::~MappedFile() {
+	if (data == nullptr) return;
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap((void*)data, size);
+#endif
+}
+
+const unsigned char* NEATNetworkFile::MappedFile::GetData() const {
+	return data;
+}
+
+size_t NEATNetworkFile::MappedFile::GetSize() const {
+	return size;
+}
+
+bool NEATNetworkFile::MappedFile::HasHeader() const {
+	return size >= sizeof(Header) && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+const NEATNetworkFile::Header& NEATNetworkFile::MappedFile::GetHeader() const {
+	return *(const Header*)data;
+}
+
+bool NEATNetworkFile::MappedFile::Validate() const {
+	if (!HasHeader()) {
+		std::cerr << "Network file is missing its header" << std::endl;
+		return false;
+	}
+
+	const Header& header = GetHeader();
+	if (header.byte_order != BYTE_ORDER_MARK) {
+		std::cerr << "Network file was saved on a machine with a different byte order" << std::endl;
+		return false;
+	}
+	if (header.version != VERSION) {
+		std::cerr << "Network file has unsupported version " << header.version << std::endl;
+		return false;
+	}
+	if (header.file_size != size) {
+		std::cerr << "Network file is truncated" << std::endl;
+		return false;
+	}
+	for (auto& e : header.sections) {
+		if (e.offset % SECTION_ALIGNMENT != 0 || e.offset < sizeof(Header) || e.offset > size || e.size > size - e.offset) {
+			std::cerr << "Network file has a section outside of the file" << std::endl;
+			return false;
+		}
+	}
+	if (FileChecksum(header, data, size) != header.checksum) {
+		std::cerr << "Network file failed its checksum" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+NEATNetworkFile::Writer::Writer() : bytes(sizeof(Header), 0) {}
+
+void NEATNetworkFile::Writer::AddSectionBytes(Section section, const void* vals, size_t size) {
+	bytes.resize((bytes.size() + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT, 0);
+	header.sections[(int)section].offset = bytes.size();
+	header.sections[(int)section].size = size;
+	bytes.insert(bytes.end(), (const unsigned char*)vals, (const unsigned char*)vals + size);
+}
+
+bool NEATNetworkFile::Writer::Write(const char* fname, int num_input_nodes, int num_output_nodes) {
+	for (auto& e : header.sections) { // sections that were never added point at the end of the header
+		if (e.offset == 0) e.offset = (sizeof(Header) + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+	}
+	bytes.resize(std::max(bytes.size(), (size_t)header.sections[0].offset), 0);
+
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.num_input_nodes = num_input_nodes;
+	header.num_output_nodes = num_output_nodes;
+	header.file_size = bytes.size();
+	header.checksum = 0;
+	std::memcpy(bytes.data(), &header, sizeof(Header));
+	header.checksum = FileChecksum(header, bytes.data(), bytes.size());
+	std::memcpy(bytes.data(), &header, sizeof(Header));
+
+	std::ofstream file{ fname, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc };
+	if (!file.is_open()) {
+		std::cerr << "Failed to open " << fname << std::endl;
+		return false;
+	}
+	file.write((const char*)bytes.data(), bytes.size());
+	file.close();
+	return !file.fail();
+}
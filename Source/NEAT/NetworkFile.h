@@ -0,0 +1,137 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "Network.h"
+
+// on-disk layout of the networks written by NetworkBaseVisual::Save
+// the file starts with a Header followed by sections that are each aligned to SECTION_ALIGNMENT bytes,
+// so a memory mapped file can be used in place: the arrays of a loaded network point straight into the mapping
+// values are stored in the native layout of the saving machine (byte_order is used to reject files from a different byte order)
+namespace NEATNetworkFile {
+	const char MAGIC[4] = { 'N', 'E', 'A', 'T' };
+	const uint32_t VERSION = 2; // version 1 is the original headerless layout (still loaded by NetworkBase::LoadImpl)
+	const uint32_t BYTE_ORDER_MARK = 0x01020304;
+	const size_t SECTION_ALIGNMENT = 64;
+
+	// sections can be empty (e.g. the packed sections of networks that don't fit in 16-bit indices)
+	// new sections should only be added before Count (and require a new VERSION)
+	enum class Section : uint32_t {
+		InputCounts = 0,
+		InputInfo,
+		OutputIndices,
+		Activations,
+		Blocks,
+		DenseSources,
+		DenseWeights,
+		PackedCounts,
+		PackedIndices,
+		PackedWeights,
+		VisualInfo,
+		LayerSizes,
+		Count
+	};
+
+	struct SectionInfo {
+		uint64_t offset = 0; // in bytes from the start of the file
+		uint64_t size = 0; // in bytes
+	};
+
+	struct Header {
+		char magic[4] = { 0, 0, 0, 0 };
+		uint32_t version = 0;
+		uint32_t byte_order = 0;
+		int32_t num_input_nodes = 0;
+		int32_t num_output_nodes = 0;
+		uint32_t reserved = 0;
+		uint64_t file_size = 0;
+		uint64_t checksum = 0; // of the whole file with this field set to 0
+		SectionInfo sections[(int)Section::Count];
+	};
+
+	// 64-bit hash used for the file checksum (pass the previous result as hash to continue hashing)
+	uint64_t Checksum(const unsigned char* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL);
+
+	// read-only memory mapping of a whole file (POSIX mmap or Windows file mapping)
+	class MappedFile {
+	public:
+		static std::shared_ptr<const MappedFile> Open(const char* fname); // returns nullptr if the file can't be mapped (e.g. it's empty)
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const unsigned char* GetData() const;
+		size_t GetSize() const;
+
+		bool HasHeader() const; // true if the file starts with MAGIC (otherwise it may be a file in the original layout)
+		const Header& GetHeader() const; // only valid if HasHeader returns true
+		bool Validate() const; // checks the version, byte order, section bounds and checksum (prints the reason on failure)
+
+		// array pointing into the mapping (keeps the mapping alive)
+		// returns false if the size of the section isn't a multiple of sizeof(T)
+		template<typename T>
+		static bool GetArray(const std::shared_ptr<const MappedFile>& mapping, Section section, NetworkArray<T>& out) {
+			const SectionInfo& info = mapping->GetHeader().sections[(int)section];
+			if (info.size % sizeof(T) != 0) return false;
+			out = NetworkArray<T>((const T*)(mapping->GetData() + info.offset), info.size / sizeof(T), mapping);
+			return true;
+		}
+
+		template<typename T>
+		static SharedNetworkArray<T> GetSharedArray(const std::shared_ptr<const MappedFile>& mapping, Section section) {
+			NetworkArray<T> arr;
+			if (!GetArray(mapping, section, arr)) return nullptr;
+			return std::make_shared<const NetworkArray<T>>(std::move(arr));
+		}
+
+	private:
+		MappedFile() {}
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+	};
+
+	// builds a file section by section
+	class Writer {
+	public:
+		Writer();
+
+		template<typename T>
+		void AddSection(Section section, const T* vals, size_t count) {
+			AddSectionBytes(section, vals, sizeof(T) * count);
+		}
+
+		bool Write(const char* fname, int num_input_nodes, int num_output_nodes); // returns true on success
+
+	private:
+		std::vector<unsigned char> bytes;
+		Header header;
+
+		void AddSectionBytes(Section section, const void* vals, size_t size);
+	};
+}
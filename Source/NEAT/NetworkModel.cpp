@@ -0,0 +1,146 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "NetworkModel.h"
+#include <algorithm>
+
+NetworkState::NetworkState(const NetworkModel& model) {
+	if (model.IsInvalid()) return;
+	sums_scratch.resize(2 * (size_t)model.GetNumNodes()); // room for the sums and the gathered inputs of a block
+	node_vals.resize(model.GetNumNodes());
+	ResetRecurrentConnections();
+}
+
+bool NetworkState::IsInvalid() const {
+	return node_vals.empty();
+}
+
+void NetworkState::ResetRecurrentConnections() {
+	std::fill(node_vals.begin(), node_vals.end(), 0.f); // resets all neuron outputs to 0
+}
+
+NetworkModel::NetworkModel(const NetworkBase& network) : network{ network } {
+	this->network.node_vals.clear(); // the model never uses its own state
+	this->network.node_vals.shrink_to_fit();
+	this->network.sums_scratch.clear();
+	this->network.sums_scratch.shrink_to_fit();
+	this->network.batch_vals.clear();
+	this->network.batch_vals.shrink_to_fit();
+
+	if (network.IsInvalid()) return;
+
+	// a node carries over between runs if it's read by itself or a node that's evaluated before it
+	const int numNodes = GetNumNodes();
+	std::vector<char> isRecurrent(numNodes, 0);
+	int input_info_index = 0;
+	for (int i = 0; i < numNodes; ++i) {
+		const int numPrevNodes = (*network.input_counts)[i];
+		for (int j = 0; j < numPrevNodes; ++j, ++input_info_index) {
+			const int prevIndex = (*network.input_info)[input_info_index].input_index;
+			if (prevIndex >= i) isRecurrent[prevIndex] = 1;
+		}
+	}
+
+	std::vector<int> new_recurrent_nodes;
+	for (int i = 0; i < numNodes; ++i) {
+		if (isRecurrent[i]) new_recurrent_nodes.emplace_back(i);
+	}
+	recurrent_nodes = MakeSharedNetworkArray(std::move(new_recurrent_nodes));
+}
+
+bool NetworkModel::IsInvalid() const {
+	return network.IsInvalid();
+}
+
+int NetworkModel::GetNumNodes() const {
+	return network.input_counts->size();
+}
+
+int NetworkModel::GetNumInputs() const {
+	return network.num_input_nodes - 1;
+}
+
+int NetworkModel::GetNumOutputs() const {
+	return network.num_output_nodes;
+}
+
+int NetworkModel::GetStateSize() const {
+	return recurrent_nodes ? recurrent_nodes->size() : 0;
+}
+
+void NetworkModel::SaveState(const NetworkState& state, float* buffer) const {
+	const int stateSize = GetStateSize();
+	for (int i = 0; i < stateSize; ++i) {
+		buffer[i] = state.node_vals[(*recurrent_nodes)[i]];
+	}
+}
+
+void NetworkModel::RestoreState(NetworkState& state, const float* buffer) const {
+	const int stateSize = GetStateSize();
+	for (int i = 0; i < stateSize; ++i) {
+		state.node_vals[(*recurrent_nodes)[i]] = buffer[i];
+	}
+}
+
+bool NetworkModel::ForkState(const NetworkState& state, NetworkState* forks, int num_forks) const {
+	bool validStates = state.node_vals.size() == (size_t)GetNumNodes();
+	for (int f = 0; f < num_forks; ++f) {
+		if (forks[f].node_vals.size() != (size_t)GetNumNodes()) validStates = false;
+	}
+	if (!validStates) {
+		std::cerr << "ForkState failed since a state wasn't created for this model" << std::endl;
+		return false;
+	}
+
+	const int stateSize = GetStateSize();
+	for (int f = 0; f < num_forks; ++f) {
+		for (int i = 0; i < stateSize; ++i) {
+			const int node = (*recurrent_nodes)[i];
+			forks[f].node_vals[node] = state.node_vals[node];
+		}
+	}
+
+	return true;
+}
+
+NetworkStatus NetworkBinding::Bind(const NetworkModel& model, NetworkState& state, int num_inputs, int num_outputs) {
+	*this = NetworkBinding();
+
+	if (model.IsInvalid()) return NetworkStatus::InvalidModel;
+	if (state.IsInvalid() || state.node_vals.size() != (size_t)model.GetNumNodes()) return NetworkStatus::InvalidState;
+	if (num_inputs != model.GetNumInputs()) return NetworkStatus::IncorrectInputSize;
+	if (num_outputs != model.GetNumOutputs()) return NetworkStatus::IncorrectOutputSize;
+
+	this->model = &model;
+	vals = state.node_vals.data();
+	sums = state.sums_scratch.data();
+	output_indices = model.GetOutputIndices();
+	this->num_inputs = num_inputs;
+	this->num_outputs = num_outputs;
+	return NetworkStatus::Ok;
+}
+
+bool NetworkBinding::IsBound() const {
+	return model != nullptr;
+}
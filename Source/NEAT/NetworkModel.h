@@ -0,0 +1,211 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include "Network.h"
+
+class NetworkModel;
+
+// run state of a NetworkModel: the output of every node (which holds the recurrent memory) and scratch space
+// allocate one per thread or per session; it's only touched by the Run calls it's passed to
+class NetworkState {
+	friend class NetworkModel;
+	friend class NetworkBinding;
+public:
+	NetworkState() {}
+	explicit NetworkState(const NetworkModel& model);
+
+	bool IsInvalid() const;
+
+	void ResetRecurrentConnections();
+
+private:
+	std::vector<float> node_vals;
+	std::vector<float> sums_scratch; // sized once so that Run never allocates
+};
+
+// immutable compiled network that any number of threads can run at once, each with its own NetworkState
+// the model shares the arrays of the network it was created from (nothing is copied), and Run only reads them through plain pointers
+// (so there are no reference count updates per call)
+class NetworkModel {
+	friend class NetworkBinding;
+public:
+	NetworkModel() {}
+	explicit NetworkModel(const NetworkBase& network); // later changes to network (e.g. SetActivation) don't affect the model
+
+	bool IsInvalid() const;
+
+	int GetNumNodes() const;
+	int GetNumInputs() const; // excluding the bias
+	int GetNumOutputs() const;
+
+	// snapshots of the recurrent memory of a state (e.g. for branching rollouts)
+	// only the nodes whose previous output gets read by a recurrent connection are copied, since every other node is overwritten before it's read
+	// states have to have been created from this model, and none of these allocate
+	int GetStateSize() const; // number of floats written by SaveState
+	void SaveState(const NetworkState& state, float* buffer) const; // buffer has to hold GetStateSize() floats
+	void RestoreState(NetworkState& state, const float* buffer) const;
+	// copies the recurrent memory of state into every fork (returns false without copying anything if a state wasn't created for this model)
+	bool ForkState(const NetworkState& state, NetworkState* forks, int num_forks) const;
+
+	// state has to have been created from this model (or one with the same number of nodes)
+	template<typename T, typename U>
+	bool Run(NetworkState& state, const std::vector<T>& in, std::vector<U>& out) const {
+		if (IsInvalid()) {
+			std::cerr << "Run failed since NetworkModel hasn't been initialized" << std::endl;
+			return false;
+		}
+
+		if (state.node_vals.size() != (size_t)GetNumNodes()) {
+			std::cerr << "NetworkModel::Run received a state that wasn't created for this model" << std::endl;
+			return false;
+		}
+
+		if ((int)in.size() != GetNumInputs()) {
+			std::cerr << "NetworkModel::Run received input vector with incorrect size" << std::endl;
+			return false;
+		}
+
+		if ((int)out.size() != GetNumOutputs()) {
+			std::cerr << "NetworkModel::Run received output vector with incorrect size" << std::endl;
+			return false;
+		}
+
+		float* vals = state.node_vals.data();
+		for (int i = 0; i < GetNumInputs(); ++i) {
+			vals[i] = in[i];
+		}
+
+		network.RunNodes(vals, state.sums_scratch.data());
+
+		const int* outputIndices = network.output_indices->data();
+		for (int i = 0; i < GetNumOutputs(); ++i) {
+			out[i] = vals[outputIndices[i]];
+		}
+
+		return true;
+	}
+
+private:
+	NetworkBase network; // never modified after construction (only its shared arrays are used)
+	SharedNetworkArray<int> recurrent_nodes; // nodes read by a recurrent connection (the only ones that carry over between runs)
+
+	void RunNodes(float* vals, float* sums) const { network.RunNodes(vals, sums); } // for NetworkBinding
+	const int* GetOutputIndices() const { return network.output_indices->data(); } // for NetworkBinding
+};
+
+// result of NetworkBinding::Bind
+enum class NetworkStatus : int {
+	Ok = 0,
+	InvalidModel,
+	InvalidState, // state is empty or wasn't created for the model
+	IncorrectInputSize,
+	IncorrectOutputSize
+};
+
+// a model bound to a state, with everything checked once up front so that the entry points below don't check anything per call
+// only plain pointers are kept: the model and state have to outlive the binding (and the state can't be reassigned while bound)
+class NetworkBinding {
+public:
+	NetworkBinding() {}
+
+	// num_inputs and num_outputs are the sizes that the caller's buffers will have
+	NetworkStatus Bind(const NetworkModel& model, NetworkState& state, int num_inputs, int num_outputs);
+
+	bool IsBound() const;
+
+	// unchecked and allocation free (Bind must have returned Ok)
+	// in has to hold the number of inputs passed to Bind, and out receives the number of outputs passed to Bind
+	void Run(const float* in, float* out) const {
+		for (int i = 0; i < num_inputs; ++i) {
+			vals[i] = in[i];
+		}
+
+		RunNodes();
+
+		for (int i = 0; i < num_outputs; ++i) {
+			out[i] = vals[output_indices[i]];
+		}
+	}
+
+	// runs timesteps consecutive inputs through the same state (in is timesteps x inputs and out is timesteps x outputs, both row-major)
+	void RunSequence(const float* in, float* out, int timesteps) const {
+		for (int t = 0; t < timesteps; ++t) {
+			Run(in + (size_t)t * num_inputs, out + (size_t)t * num_outputs);
+		}
+	}
+
+private:
+	const NetworkModel* model = nullptr;
+	float* vals = nullptr;
+	float* sums = nullptr;
+	const int* output_indices = nullptr;
+	int num_inputs = 0;
+	int num_outputs = 0;
+
+	void RunNodes() const {
+		model->RunNodes(vals, sums);
+	}
+
+	template<int NIn, int NOut>
+	friend class FixedNetworkBinding;
+};
+
+// NetworkBinding with the buffer sizes fixed at compile time (Bind checks them against the model once, so Run doesn't check anything)
+template<int NIn, int NOut>
+class FixedNetworkBinding {
+public:
+	NetworkStatus Bind(const NetworkModel& model, NetworkState& state) {
+		return binding.Bind(model, state, NIn, NOut);
+	}
+
+	bool IsBound() const {
+		return binding.IsBound();
+	}
+
+	// unchecked and allocation free (Bind must have returned Ok)
+	void Run(const float(&in)[NIn], float(&out)[NOut]) const {
+		for (int i = 0; i < NIn; ++i) {
+			binding.vals[i] = in[i];
+		}
+
+		binding.RunNodes();
+
+		for (int i = 0; i < NOut; ++i) {
+			out[i] = binding.vals[binding.output_indices[i]];
+		}
+	}
+
+private:
+	NetworkBinding binding;
+};
+
+// safe to call from many threads at once as long as each call gets its own state
+template<typename T, typename U>
+bool Run(const NetworkModel& model, NetworkState& state, const std::vector<T>& in, std::vector<U>& out) {
+	return model.Run(state, in, out);
+}
@@ -0,0 +1,190 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "PopulationEvaluator.h"
+#include <map>
+#include <algorithm>
+
+PopulationEvaluator::PopulationEvaluator(const std::vector<std::tuple<NetworkBaseVisual, FitnessInterface, int>>& networks) {
+	std::vector<const NetworkBase*> networkPtrs;
+	networkPtrs.reserve(networks.size());
+	for (auto& e : networks) {
+		networkPtrs.emplace_back(&std::get<0>(e));
+	}
+	Build(networkPtrs);
+}
+
+PopulationEvaluator::PopulationEvaluator(const std::vector<std::tuple<NetworkBase, FitnessInterface, int>>& networks) {
+	std::vector<const NetworkBase*> networkPtrs;
+	networkPtrs.reserve(networks.size());
+	for (auto& e : networks) {
+		networkPtrs.emplace_back(&std::get<0>(e));
+	}
+	Build(networkPtrs);
+}
+
+PopulationEvaluator::PopulationEvaluator(const std::vector<const NetworkBase*>& networks) {
+	Build(networks);
+}
+
+bool PopulationEvaluator::IsInvalid() const {
+	return network_lanes.empty();
+}
+
+int PopulationEvaluator::GetNumNetworks() const {
+	return network_lanes.size();
+}
+
+int PopulationEvaluator::GetNumGroups() const {
+	return groups.size();
+}
+
+void PopulationEvaluator::Build(const std::vector<const NetworkBase*>& networks) {
+	if (networks.empty()) return;
+
+	num_input_nodes = networks[0]->num_input_nodes;
+	num_output_nodes = networks[0]->num_output_nodes;
+
+	// group networks by topology (node input counts, input indices, output indices and activations)
+	std::map<std::vector<int>, int> topologyGroups;
+	std::vector<std::vector<const NetworkBase*>> groupMembers;
+	std::vector<NetworkLane> lanes;
+	lanes.reserve(networks.size());
+
+	std::vector<int> key;
+	for (auto network : networks) {
+		if (network->IsInvalid() || network->num_input_nodes != num_input_nodes || network->num_output_nodes != num_output_nodes) {
+			std::cerr << "Failed to initialize PopulationEvaluator since the networks are invalid or have different input/output sizes" << std::endl;
+			return;
+		}
+
+		key.clear();
+		key.insert(key.end(), network->input_counts->begin(), network->input_counts->end());
+		for (auto& e : *(network->input_info)) {
+			key.emplace_back(e.input_index);
+		}
+		key.insert(key.end(), network->output_indices->begin(), network->output_indices->end());
+		for (auto& e : *(network->node_activations)) {
+			key.emplace_back((int)e);
+		}
+
+		auto it = topologyGroups.find(key);
+		if (it == topologyGroups.end()) {
+			it = topologyGroups.emplace(key, (int)groupMembers.size()).first;
+			groupMembers.emplace_back();
+		}
+		lanes.emplace_back(it->second, (int)groupMembers[it->second].size());
+		groupMembers[it->second].emplace_back(network);
+	}
+
+	// pack the groups into the arenas
+	groups.resize(groupMembers.size());
+	for (size_t g = 0; g < groupMembers.size(); ++g) {
+		const NetworkBase& first = *groupMembers[g][0];
+		GroupInfo& group = groups[g];
+		group.num_lanes = groupMembers[g].size();
+		group.num_nodes = first.input_counts->size();
+		group.num_edges = first.input_info->size();
+		group.topology_start_index = topology_arena.size();
+		group.activation_start_index = activation_arena.size();
+		group.weight_start_index = weight_arena.size();
+		group.value_start_index = value_arena.size();
+
+		topology_arena.insert(topology_arena.end(), first.input_counts->begin(), first.input_counts->end());
+		for (auto& e : *(first.input_info)) {
+			topology_arena.emplace_back(e.input_index);
+		}
+		topology_arena.insert(topology_arena.end(), first.output_indices->begin(), first.output_indices->end());
+		activation_arena.insert(activation_arena.end(), first.node_activations->begin(), first.node_activations->end());
+
+		weight_arena.resize(weight_arena.size() + (size_t)group.num_edges * group.num_lanes);
+		float* weights = &weight_arena[group.weight_start_index];
+		for (int lane = 0; lane < group.num_lanes; ++lane) {
+			const NetworkBase& laneNetwork = *groupMembers[g][lane];
+			for (int j = 0; j < group.num_edges; ++j) {
+				weights[(size_t)j * group.num_lanes + lane] = laneNetwork.GetRunWeight(j); // (rounded like Run when using half precision weights)
+			}
+		}
+
+		value_arena.resize(value_arena.size() + (size_t)group.num_nodes * group.num_lanes, 0);
+	}
+
+	network_lanes = lanes;
+	shared_input.resize(num_input_nodes - 1);
+
+	size_t maxLanes = 0;
+	for (auto& e : groups) {
+		maxLanes = std::max(maxLanes, (size_t)e.num_lanes);
+	}
+	sums_scratch.resize(maxLanes);
+}
+
+void PopulationEvaluator::ResetRecurrentConnections() {
+	std::fill(value_arena.begin(), value_arena.end(), 0.f);
+}
+
+void PopulationEvaluator::RunGroups(std::vector<float>& out) {
+	float* sums = sums_scratch.data();
+
+	for (auto& group : groups) {
+		const int numLanes = group.num_lanes;
+		const int* blockSizes = &topology_arena[group.topology_start_index];
+		const int* inputIndices = blockSizes + group.num_nodes;
+		const NEATActivation::Type* activations = &activation_arena[group.activation_start_index];
+		const float* weights = weight_arena.data() + group.weight_start_index;
+		float* vals = &value_arena[group.value_start_index];
+
+		// the input (and bias) is the same for every network in the group
+		for (int i = 0; i < num_input_nodes; ++i) {
+			const float inputVal = (i == num_input_nodes - 1) ? 1.f : shared_input[i]; // bias always set to 1
+			std::fill(vals + (size_t)i * numLanes, vals + (size_t)(i + 1) * numLanes, inputVal);
+		}
+
+		int edgeIndex = 0;
+		for (int i = num_input_nodes; i < group.num_nodes; ++i) {
+			const int numPrevNodes = blockSizes[i];
+			std::fill(sums, sums + numLanes, 0.f);
+
+			for (int j = 0; j < numPrevNodes; ++j, ++edgeIndex) {
+				const float* src = vals + (size_t)inputIndices[edgeIndex] * numLanes;
+				const float* laneWeights = weights + (size_t)edgeIndex * numLanes;
+				for (int lane = 0; lane < numLanes; ++lane) {
+					sums[lane] += src[lane] * laneWeights[lane];
+				}
+			}
+
+			NEATActivation::ApplyBlock(activations[i], sums, numLanes); // vectorized across networks
+			std::copy(sums, sums + numLanes, vals + (size_t)i * numLanes);
+		}
+	}
+
+	for (size_t n = 0; n < network_lanes.size(); ++n) {
+		const GroupInfo& group = groups[network_lanes[n].group];
+		const int* outputIndices = &topology_arena[group.topology_start_index] + group.num_nodes + group.num_edges;
+		const float* vals = &value_arena[group.value_start_index];
+		for (int i = 0; i < num_output_nodes; ++i) {
+			out[n * num_output_nodes + i] = vals[(size_t)outputIndices[i] * group.num_lanes + network_lanes[n].lane];
+		}
+	}
+}
@@ -0,0 +1,114 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <tuple>
+#include "Network.h"
+#include "NEAT.h"
+
+// evaluates a whole population of networks in lockstep on the same input
+// all of the networks are packed into contiguous arenas, and networks with identical topology are grouped together
+// so that their weights are processed as SIMD lanes (the topology of a group is only walked once per Run)
+// each network keeps its own recurrent state between calls, and results are bit-identical to calling NetworkBase::Run on each network
+class PopulationEvaluator {
+public:
+	PopulationEvaluator() {}
+	PopulationEvaluator(const std::vector<std::tuple<NetworkBaseVisual, FitnessInterface, int>>& networks); // output of NEAT::GenerateNetworks
+	PopulationEvaluator(const std::vector<std::tuple<NetworkBase, FitnessInterface, int>>& networks); // output of NEAT::GenerateLeanNetworks
+	PopulationEvaluator(const std::vector<const NetworkBase*>& networks);
+
+	bool IsInvalid() const; // true if there are no networks or the networks don't share the same input and output sizes
+
+	void ResetRecurrentConnections();
+
+	int GetNumNetworks() const;
+	int GetNumGroups() const; // for debugging (number of distinct topologies)
+
+	// runs every network on the same input
+	// out is a row-major (number of networks x output size) matrix with rows in the order the networks were passed in
+	template<typename T>
+	bool Run(const std::vector<T>& in, std::vector<float>& out) {
+		if (IsInvalid()) {
+			std::cerr << "Run failed since PopulationEvaluator hasn't been initialized" << std::endl;
+			return false;
+		}
+
+		if ((int)in.size() != (num_input_nodes - 1)) {
+			std::cerr << "PopulationEvaluator::Run received input vector with incorrect size" << std::endl;
+			return false;
+		}
+
+		out.resize((size_t)network_lanes.size() * num_output_nodes);
+
+		for (int i = 0; i < (num_input_nodes - 1); ++i) {
+			shared_input[i] = in[i];
+		}
+
+		RunGroups(out);
+
+		return true;
+	}
+
+private:
+	// a set of networks with the same topology
+	// topology_arena holds the input counts of the group's nodes followed by the input indices of its edges and its output indices
+	// weight_arena holds its weights edge-major (the weights of one edge for every network are contiguous)
+	// value_arena holds its node outputs node-major (the outputs of one node for every network are contiguous)
+	struct GroupInfo {
+		int num_lanes = 0;
+		int num_nodes = 0;
+		int num_edges = 0;
+		int topology_start_index = 0;
+		int activation_start_index = 0;
+		int weight_start_index = 0;
+		size_t value_start_index = 0;
+	};
+
+	// location of a network within the groups
+	struct NetworkLane {
+		int group = 0;
+		int lane = 0;
+		NetworkLane(int argGroup, int argLane) : group{ argGroup }, lane{ argLane } {}
+		NetworkLane() {}
+	};
+
+	int num_input_nodes = 0;
+	int num_output_nodes = 0;
+
+	std::vector<GroupInfo> groups;
+	std::vector<NetworkLane> network_lanes;
+
+	std::vector<int> topology_arena;
+	std::vector<NEATActivation::Type> activation_arena;
+	std::vector<float> weight_arena;
+	std::vector<float> value_arena;
+
+	std::vector<float> shared_input;
+	std::vector<float> sums_scratch;
+
+	void Build(const std::vector<const NetworkBase*>& networks);
+	void RunGroups(std::vector<float>& out); // helper for Run
+};
@@ -0,0 +1,232 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "QuantizedNetwork.h"
+#include "SIMD.h"
+#include <cmath>
+#include <algorithm>
+
+static constexpr float Q15_SCALE = 1.f / 32767; // scale of outputs bounded to [-1, 1]
+
+// lookup tables map a weighted sum to a Q15 output
+static constexpr int LUT_SIZE = 4096;
+static constexpr float TANH_LUT_RANGE = 5.f; // tanh(5) rounds to 1 in Q15 within a couple of steps
+static constexpr float SIGMOID_LUT_RANGE = 10.f;
+
+namespace {
+	struct ActivationLUT {
+		short vals[LUT_SIZE];
+		float range = 0;
+		ActivationLUT(float argRange, bool isSigmoid) : range{ argRange } {
+			for (int i = 0; i < LUT_SIZE; ++i) {
+				const float x = ((float)i / (LUT_SIZE - 1) * 2 - 1) * range;
+				const float y = isSigmoid ? 1.f / (1.f + std::exp(-x)) : std::tanh(x);
+				vals[i] = (short)std::lround(y * 32767);
+			}
+		}
+		short Lookup(float x) const {
+			const float pos = (x / range + 1) * 0.5f * (LUT_SIZE - 1);
+			if (!(pos > 0)) return vals[0]; // also catches nan
+			if (pos >= LUT_SIZE - 1) return vals[LUT_SIZE - 1];
+			return vals[(int)(pos + 0.5f)];
+		}
+	};
+}
+
+static const ActivationLUT& TanhLUT() {
+	static const ActivationLUT lut(TANH_LUT_RANGE, false);
+	return lut;
+}
+
+static const ActivationLUT& SigmoidLUT() {
+	static const ActivationLUT lut(SIGMOID_LUT_RANGE, true);
+	return lut;
+}
+
+QuantizedNetwork::QuantizedNetwork(const NetworkBase& network, const std::vector<std::vector<float>>& calibration_inputs) {
+	if (network.IsInvalid()) {
+		std::cerr << "Failed to initialize QuantizedNetwork since the network is invalid" << std::endl;
+		return;
+	}
+
+	for (auto& e : calibration_inputs) {
+		if ((int)e.size() != (network.num_input_nodes - 1)) {
+			std::cerr << "Failed to initialize QuantizedNetwork since a calibration input has incorrect size" << std::endl;
+			return;
+		}
+	}
+
+	Calibrate(network, calibration_inputs);
+	MeasureError(network, calibration_inputs);
+}
+
+bool QuantizedNetwork::IsInvalid() const {
+	return node_vals.empty();
+}
+
+void QuantizedNetwork::ResetRecurrentConnections() {
+	std::fill(node_vals.begin(), node_vals.end(), 0);
+	if (!node_vals.empty()) node_vals[num_input_nodes - 1] = 32767; // bias always set to 1
+}
+
+float QuantizedNetwork::GetMaxError() const {
+	return max_error;
+}
+
+float QuantizedNetwork::GetMeanError() const {
+	return mean_error;
+}
+
+int QuantizedNetwork::GetNumWeightBytes() const {
+	return weights.size() * sizeof(signed char) + weight_scales.size() * sizeof(float);
+}
+
+short QuantizedNetwork::Quantize(float val, float scale) {
+	const float q = std::round(val / scale);
+	if (!(q > -32767)) return -32767; // also catches nan
+	if (q > 32767) return 32767;
+	return (short)q;
+}
+
+void QuantizedNetwork::Calibrate(NetworkBase network, const std::vector<std::vector<float>>& calibration_inputs) {
+	const int numNodes = network.input_counts->size();
+	num_input_nodes = network.num_input_nodes;
+	input_counts.assign(network.input_counts->begin(), network.input_counts->end());
+	node_activations.assign(network.node_activations->begin(), network.node_activations->end());
+	output_indices.assign(network.output_indices->begin(), network.output_indices->end());
+
+	// largest output of every node over the calibration inputs
+	std::vector<float> maxAbs(numNodes, 0);
+	std::vector<float> outputs(network.num_output_nodes);
+	network.ResetRecurrentConnections();
+	for (auto& e : calibration_inputs) {
+		network.Run(e, outputs);
+		for (int i = 0; i < numNodes; ++i) {
+			maxAbs[i] = std::max(maxAbs[i], std::fabs(network.node_vals[i]));
+		}
+	}
+
+	node_scales.resize(numNodes);
+	for (int i = 0; i < numNodes; ++i) {
+		switch (node_activations[i]) {
+		case NEATActivation::Type::ReLU:
+		case NEATActivation::Type::Identity:
+			node_scales[i] = (maxAbs[i] > 0 && std::isfinite(maxAbs[i])) ? maxAbs[i] / 32767 : Q15_SCALE; // unbounded so use the calibrated range
+			break;
+		default:
+			node_scales[i] = Q15_SCALE;
+			break;
+		}
+	}
+	node_scales[num_input_nodes - 1] = Q15_SCALE; // bias
+
+	// fold the scale of each input into its weight, then quantize the weights of every node against their largest magnitude
+	input_indices.reserve(network.input_info->size());
+	weights.reserve(network.input_info->size());
+	weight_scales.assign(numNodes, 0);
+	std::vector<float> scaledWeights;
+	int inputInfoIndex = 0;
+	for (int i = 0; i < numNodes; ++i) {
+		scaledWeights.clear();
+		float maxWeight = 0;
+		for (int j = 0; j < input_counts[i]; ++j, ++inputInfoIndex) {
+			const int inputIndex = (*network.input_info)[inputInfoIndex].input_index;
+			const float w = network.GetRunWeight(inputInfoIndex) * node_scales[inputIndex];
+			input_indices.emplace_back(inputIndex);
+			scaledWeights.emplace_back(w);
+			maxWeight = std::max(maxWeight, std::fabs(w));
+		}
+
+		weight_scales[i] = (maxWeight > 0) ? maxWeight / 127 : 0;
+		for (auto w : scaledWeights) {
+			weights.emplace_back((maxWeight > 0) ? (signed char)std::lround(w / weight_scales[i]) : 0);
+		}
+	}
+
+	node_vals.resize(numNodes);
+	ResetRecurrentConnections();
+}
+
+void QuantizedNetwork::MeasureError(NetworkBase network, const std::vector<std::vector<float>>& calibration_inputs) {
+	std::vector<float> expected(network.num_output_nodes);
+	std::vector<float> actual(network.num_output_nodes);
+	double errorSum = 0;
+	network.ResetRecurrentConnections();
+	for (auto& e : calibration_inputs) {
+		network.Run(e, expected);
+		Run(e, actual);
+		for (int i = 0; i < network.num_output_nodes; ++i) {
+			const float error = std::fabs(expected[i] - actual[i]);
+			max_error = std::max(max_error, error);
+			errorSum += error;
+		}
+	}
+
+	if (!calibration_inputs.empty()) {
+		mean_error = errorSum / ((double)calibration_inputs.size() * network.num_output_nodes);
+	}
+	ResetRecurrentConnections();
+}
+
+void QuantizedNetwork::RunNodes() {
+	const ActivationLUT& tanhLUT = TanhLUT();
+	const ActivationLUT& sigmoidLUT = SigmoidLUT();
+
+	// nodes are evaluated one at a time in order, which reads the same values as the blocks in NetworkBase::Run
+	// since no node reads an earlier node of its own block
+	gather_scratch.resize(input_counts.size());
+	int inputInfoIndex = 0;
+	for (int i = 0; i < (int)input_counts.size(); ++i) {
+		const int count = input_counts[i];
+		if (i < num_input_nodes) {
+			inputInfoIndex += count;
+			continue;
+		}
+
+		for (int j = 0; j < count; ++j) {
+			gather_scratch[j] = node_vals[input_indices[inputInfoIndex + j]];
+		}
+		const float sum = NEATSIMD::DotInt8Int16(weights.data() + inputInfoIndex, gather_scratch.data(), count) * weight_scales[i];
+		inputInfoIndex += count;
+
+		switch (node_activations[i]) {
+		case NEATActivation::Type::Tanh:
+		case NEATActivation::Type::FastTanh:
+			node_vals[i] = tanhLUT.Lookup(sum);
+			break;
+		case NEATActivation::Type::Sigmoid:
+			node_vals[i] = sigmoidLUT.Lookup(sum);
+			break;
+		case NEATActivation::Type::ReLU:
+			node_vals[i] = Quantize(std::max(sum, 0.f), node_scales[i]);
+			break;
+		case NEATActivation::Type::ClampedLinear:
+			node_vals[i] = Quantize(std::min(std::max(sum, -1.f), 1.f), node_scales[i]);
+			break;
+		default:
+			node_vals[i] = Quantize(sum, node_scales[i]);
+			break;
+		}
+	}
+}
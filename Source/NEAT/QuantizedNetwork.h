@@ -0,0 +1,104 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include "Network.h"
+
+// fixed-point copy of a NetworkBase for targets where float math is slow or memory is tight
+// weights are stored as int8 with a scale per node, node outputs as int16 with a scale per node, and sums are accumulated in int32
+// tanh, fast tanh and sigmoid are evaluated with lookup tables
+// the scales of inputs and of unbounded nodes (ReLU and Identity) are taken from the largest outputs seen while running the calibration inputs;
+// values outside of the calibrated range saturate
+class QuantizedNetwork {
+public:
+	QuantizedNetwork() {}
+	// calibration_inputs are run through the network in order (as consecutive calls to NetworkBase::Run starting from a reset state)
+	// and then through the quantized network to measure the error (see GetMaxError and GetMeanError)
+	QuantizedNetwork(const NetworkBase& network, const std::vector<std::vector<float>>& calibration_inputs);
+
+	bool IsInvalid() const;
+
+	void ResetRecurrentConnections();
+
+	// error of the outputs against the float network over the calibration inputs
+	float GetMaxError() const;
+	float GetMeanError() const;
+
+	int GetNumWeightBytes() const; // for debugging (memory used by the quantized weights and their scales)
+
+	template<typename T, typename U>
+	bool Run(const std::vector<T>& in, std::vector<U>& out) {
+		if (IsInvalid()) {
+			std::cerr << "Run failed since QuantizedNetwork hasn't been initialized" << std::endl;
+			return false;
+		}
+
+		if ((int)in.size() != (num_input_nodes - 1)) {
+			std::cerr << "QuantizedNetwork::Run received input vector with incorrect size" << std::endl;
+			return false;
+		}
+
+		if (out.size() != output_indices.size()) {
+			std::cerr << "QuantizedNetwork::Run received output vector with incorrect size" << std::endl;
+			return false;
+		}
+
+		for (int i = 0; i < (num_input_nodes - 1); ++i) {
+			node_vals[i] = Quantize((float)in[i], node_scales[i]);
+		}
+
+		RunNodes();
+
+		for (int i = 0; i < (int)output_indices.size(); ++i) {
+			out[i] = node_vals[output_indices[i]] * node_scales[output_indices[i]];
+		}
+
+		return true;
+	}
+
+private:
+	int num_input_nodes = 0;
+
+	std::vector<int> input_counts;
+	std::vector<int> input_indices;
+	std::vector<signed char> weights; // each weight already includes the scale of its input
+	std::vector<float> weight_scales; // per node; converts the int32 sum back to the real weighted sum
+	std::vector<float> node_scales; // per node; real output = node_vals * node_scales
+	std::vector<NEATActivation::Type> node_activations;
+	std::vector<int> output_indices;
+
+	std::vector<short> node_vals;
+	std::vector<short> gather_scratch; // inputs of the current node packed contiguously for the dot product
+
+	float max_error = 0;
+	float mean_error = 0;
+
+	static short Quantize(float val, float scale);
+	void Calibrate(NetworkBase network, const std::vector<std::vector<float>>& calibration_inputs); // helper for the ctor
+	void MeasureError(NetworkBase network, const std::vector<std::vector<float>>& calibration_inputs); // helper for the ctor
+	void RunNodes(); // helper for Run
+};
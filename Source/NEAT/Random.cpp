@@ -0,0 +1,170 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "Random.h"
+#include <atomic>
+#include <cmath>
+
+static unsigned long long SplitMix64(unsigned long long& x) {
+	unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+NEATRandom::Engine::Engine(unsigned long long seed, unsigned long long stream) {
+	unsigned long long streamState = stream;
+	unsigned long long state = seed ^ SplitMix64(streamState); // streams start splitmix64 at unrelated points
+	for (auto& e : s) {
+		e = SplitMix64(state);
+	}
+}
+
+// Lemire's multiply and shift (only redraws for the few values that would make the result biased)
+int NEATRandom::Engine::UniformInt(int max) {
+	if (max <= 0) return max;
+	const unsigned long long range = (unsigned long long)max + 1;
+	unsigned long long m = (Next() >> 32) * range;
+	unsigned int low = (unsigned int)m;
+	if (low < range) {
+		const unsigned int threshold = (unsigned int)((0x100000000ULL - range) % range);
+		while (low < threshold) {
+			m = (Next() >> 32) * range;
+			low = (unsigned int)m;
+		}
+	}
+	return (int)(m >> 32);
+}
+
+// layers of the ziggurat (Marsaglia and Tsang, "The Ziggurat Method for Generating Random Variables")
+struct ZigguratTables {
+	static constexpr double R = 3.442619855899; // start of the tail
+	unsigned int kn[128]; // values of |hz| that are inside the layer
+	double wn[128]; // hz -> x
+	double fn[128]; // density at the edge of each layer
+
+	ZigguratTables() {
+		const double m1 = 2147483648.0;
+		const double vn = 9.91256303526217e-3; // area of each layer
+		double dn = R;
+		double tn = dn;
+		const double q = vn / std::exp(-0.5 * dn * dn);
+
+		kn[0] = (unsigned int)((dn / q) * m1);
+		kn[1] = 0;
+		wn[0] = q / m1;
+		wn[127] = dn / m1;
+		fn[0] = 1;
+		fn[127] = std::exp(-0.5 * dn * dn);
+		for (int i = 126; i >= 1; --i) {
+			dn = std::sqrt(-2 * std::log(vn / dn + std::exp(-0.5 * dn * dn)));
+			kn[i + 1] = (unsigned int)((dn / tn) * m1);
+			tn = dn;
+			fn[i] = std::exp(-0.5 * dn * dn);
+			wn[i] = dn / m1;
+		}
+	}
+};
+
+static const ZigguratTables& GetZiggurat() {
+	static const ZigguratTables tables; // (built on first use, so it also works during static initialization)
+	return tables;
+}
+
+// the layer comes from the low 7 bits and the position in the layer from the upper 32 bits, so they don't overlap
+double NEATRandom::Engine::Gaussian() {
+	const ZigguratTables& tables = GetZiggurat();
+	const unsigned long long bits = Next();
+	const int iz = bits & 127;
+	const long long hz = (int)(bits >> 32);
+	if ((unsigned long long)(hz < 0 ? -hz : hz) < tables.kn[iz]) return hz * tables.wn[iz];
+	return GaussianTail(hz, iz);
+}
+
+double NEATRandom::Engine::GaussianTail(long long hz, int iz) {
+	const ZigguratTables& tables = GetZiggurat();
+	for (;;) {
+		const double x = hz * tables.wn[iz];
+		if (iz == 0) { // base layer; draw from the tail beyond R
+			double tailX;
+			double tailY;
+			do {
+				tailX = -std::log(UniformOpen()) / ZigguratTables::R;
+				tailY = -std::log(UniformOpen());
+			} while (tailY + tailY < tailX * tailX);
+			return (hz > 0) ? (ZigguratTables::R + tailX) : (-ZigguratTables::R - tailX);
+		}
+		if (tables.fn[iz] + Uniform() * (tables.fn[iz - 1] - tables.fn[iz]) < std::exp(-0.5 * x * x)) return x; // under the density
+
+		const unsigned long long bits = Next();
+		iz = bits & 127;
+		hz = (int)(bits >> 32);
+		if ((unsigned long long)(hz < 0 ? -hz : hz) < tables.kn[iz]) return hz * tables.wn[iz];
+	}
+}
+
+void NEATRandom::Engine::FillUniform(float* vals, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		vals[i] = (Next() >> 40) * (1.0f / 16777216.0f); // 24 bits so the result stays below 1
+	}
+}
+
+void NEATRandom::Engine::FillGaussian(float* vals, size_t count, float stdDev) {
+	for (size_t i = 0; i < count; ++i) {
+		vals[i] = stdDev * Gaussian();
+	}
+}
+
+static std::atomic<unsigned long long> master_seed{ NEATRandom::DEFAULT_SEED };
+static std::atomic<unsigned long long> next_thread_stream{ 0 };
+static const unsigned long long THREAD_STREAM_BIT = 1ULL << 63; // (keeps the streams of the threads apart from the ones of ScopedStream)
+static thread_local NEATRandom::Engine* current_engine = nullptr; // set by ScopedStream (nullptr means the thread's own engine)
+
+static NEATRandom::Engine& GetThreadEngine() {
+	thread_local NEATRandom::Engine engine(master_seed.load(), THREAD_STREAM_BIT | next_thread_stream++);
+	return engine;
+}
+
+void NEATRandom::SetSeed(unsigned long long seed) {
+	Engine& engine = GetThreadEngine();
+	master_seed = seed;
+	engine = Engine(seed, THREAD_STREAM_BIT);
+	next_thread_stream = 1;
+}
+
+unsigned long long NEATRandom::GetSeed() {
+	return master_seed.load();
+}
+
+NEATRandom::Engine& NEATRandom::GetEngine() {
+	return (current_engine != nullptr) ? *current_engine : GetThreadEngine();
+}
+
+NEATRandom::ScopedStream::ScopedStream(unsigned long long stream) : engine(GetSeed(), stream), previous{ current_engine } {
+	current_engine = &engine;
+}
+
+NEATRandom::ScopedStream::~ScopedStream() {
+	current_engine = previous;
+}
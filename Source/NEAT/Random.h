@@ -0,0 +1,89 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+// random numbers used by NEAT (mutation, crossover and selection all draw through NEATMathHelpers, which uses this)
+// every thread draws from its own engine, so drawing is thread-safe, and all engines are derived from one master seed
+namespace NEATRandom {
+	const unsigned long long DEFAULT_SEED = 0x853c49e6748fea9bULL;
+
+	// xoshiro256++ (256 bits of state, period 2^256 - 1)
+	// the state is filled with splitmix64, so any seed (and any stream of a seed) gives a usable state
+	class Engine {
+	public:
+		Engine(unsigned long long seed = DEFAULT_SEED, unsigned long long stream = 0); // different streams of the same seed are independent
+
+		unsigned long long Next() {
+			const unsigned long long result = Rotl(s[0] + s[3], 23) + s[0];
+			const unsigned long long t = s[1] << 17;
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = Rotl(s[3], 45);
+			return result;
+		}
+
+		double Uniform() { return (Next() >> 11) * (1.0 / 9007199254740992.0); } // [0, 1) with 53 bits
+		int UniformInt(int max); // [0, max] without modulo bias (returns max if max <= 0)
+		double Gaussian(); // standard normal (ziggurat with 128 layers)
+
+		// batch versions (avoid looking up the engine of the thread for every value when called through NEATMathHelpers)
+		void FillUniform(float* vals, size_t count); // [0, 1)
+		void FillGaussian(float* vals, size_t count, float stdDev);
+
+	private:
+		unsigned long long s[4];
+		static unsigned long long Rotl(unsigned long long x, int k) { return (x << k) | (x >> (64 - k)); }
+		double UniformOpen() { return ((Next() >> 11) + 0.5) * (1.0 / 9007199254740992.0); } // (0, 1) for taking logs
+		double GaussianTail(long long hz, int iz); // helper for Gaussian (the rare case that isn't inside a layer)
+	};
+
+	// the master seed; also restarts the calling thread on the first thread stream of the seed
+	// other threads start on the next unused thread stream the first time they draw a number (so their streams depend on the order they start in;
+	// use ScopedStream for work that has to be reproducible across thread counts)
+	void SetSeed(unsigned long long seed);
+	unsigned long long GetSeed();
+
+	Engine& GetEngine(); // engine the calling thread currently draws from
+
+	// makes the calling thread draw from stream stream of the master seed until it goes out of scope
+	// (e.g. one stream per task, so results don't depend on which thread ran the task)
+	// streams should be below 2^63 since the streams of the threads use the upper half
+	class ScopedStream {
+	public:
+		ScopedStream(unsigned long long stream);
+		~ScopedStream();
+		ScopedStream(const ScopedStream&) = delete;
+		ScopedStream& operator=(const ScopedStream&) = delete;
+
+	private:
+		Engine engine;
+		Engine* previous;
+	};
+}
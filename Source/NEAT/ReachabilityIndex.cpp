@@ -0,0 +1,73 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "ReachabilityIndex.h"
+#include <iostream>
+
+void ReachabilityIndex::Build(int num_nodes_in, const std::vector<std::pair<int, int>>& edges) {
+	num_nodes = num_nodes_in;
+	words_per_node = (num_nodes + 63) / 64;
+	bits.assign((size_t)num_nodes * words_per_node, 0);
+
+	edge_starts.assign(num_nodes + 1, 0);
+	for (auto& e : edges) {
+		++edge_starts[e.first + 1];
+	}
+	for (int i = 0; i < num_nodes; ++i) {
+		edge_starts[i + 1] += edge_starts[i];
+	}
+	edge_targets.resize(edges.size());
+	for (auto& e : edges) {
+		edge_targets[edge_starts[e.first]++] = e.second; // (moves the start of each node to the end of its edges)
+	}
+	for (int i = num_nodes; i > 0; --i) { // so shift them back
+		edge_starts[i] = edge_starts[i - 1];
+	}
+	edge_starts[0] = 0;
+
+	// readers come after the nodes they read from, so go backwards and merge in the rows of the readers
+	for (int i = num_nodes - 1; i >= 0; --i) {
+		unsigned long long* row = &bits[(size_t)i * words_per_node];
+		row[i >> 6] |= 1ull << (i & 63);
+		for (int j = edge_starts[i]; j < edge_starts[i + 1]; ++j) {
+			const int target = edge_targets[j];
+			if (target <= i) {
+				std::cerr << "ReachabilityIndex edge " << i << " -> " << target << " isn't in topological order" << std::endl;
+				continue;
+			}
+			const unsigned long long* targetRow = &bits[(size_t)target * words_per_node];
+			for (int w = target >> 6; w < words_per_node; ++w) { // (nothing below target is reachable from it)
+				row[w] |= targetRow[w];
+			}
+		}
+	}
+}
+
+int ReachabilityIndex::GetNumNodes() const {
+	return num_nodes;
+}
+
+size_t ReachabilityIndex::GetNumBytes() const {
+	return bits.size() * sizeof(unsigned long long);
+}
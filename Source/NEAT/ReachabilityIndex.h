@@ -0,0 +1,55 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// answers "is there a path from node a to node b" for a DAG in O(1) (used to tell whether a new edge would close a cycle)
+// nodes have to be numbered in topological order (every edge goes from a lower to a higher index),
+// and each node gets a bitset of the nodes it can reach (transitive closure; nothing below its own index is ever set)
+// building is O(edges * nodes / 64) and reuses its buffers, so rebuilding the same index doesn't allocate once it's big enough
+class ReachabilityIndex {
+public:
+	void Build(int num_nodes, const std::vector<std::pair<int, int>>& edges); // edges are (from index, to index)
+
+	bool CanReach(int from, int to) const { // a node reaches itself
+		if (to < from) return false; // (topological order)
+		return (bits[(size_t)from * words_per_node + (to >> 6)] >> (to & 63)) & 1;
+	}
+
+	int GetNumNodes() const;
+	size_t GetNumBytes() const; // for debugging
+
+private:
+	int num_nodes = 0;
+	int words_per_node = 0;
+	std::vector<unsigned long long> bits; // row i holds the nodes reachable from node i
+
+	// edges grouped by their from node (compressed sparse rows)
+	std::vector<int> edge_starts;
+	std::vector<int> edge_targets;
+};
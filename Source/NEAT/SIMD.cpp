@@ -0,0 +1,192 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "SIMD.h"
+
+#if defined(NEAT_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef NEAT_SIMD_X86
+static bool CPUSupportsAVX2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7) return false;
+	__cpuid(regs, 1);
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	const bool avx = (regs[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	if ((_xgetbv(0) & 0x6) != 0x6) return false; // OS must save the ymm registers
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static NEATSIMD::Level DetectLevel() {
+#ifdef NEAT_SIMD_X86
+	return CPUSupportsAVX2() ? NEATSIMD::Level::AVX2 : NEATSIMD::Level::SSE;
+#elif defined(NEAT_SIMD_NEON)
+	return NEATSIMD::Level::NEON;
+#else
+	return NEATSIMD::Level::Scalar;
+#endif
+}
+
+NEATSIMD::Level NEATSIMD::GetLevel() {
+	static const Level level = DetectLevel(); // thread-safe since C++11 static initialization
+	return level;
+}
+
+const char* NEATSIMD::GetLevelName(Level level) {
+	switch (level) {
+	case Level::SSE: return "SSE";
+	case Level::AVX2: return "AVX2";
+	case Level::NEON: return "NEON";
+	default: return "Scalar";
+	}
+}
+
+// each vector kernel processes as many whole vectors of rows as fit and returns the number of rows it handled
+
+#ifdef NEAT_SIMD_X86
+NEAT_TARGET_AVX2 static int DenseMatVecAVX2(const float* weights, const float* x, int rows, int cols, float* out) {
+	int r = 0;
+	for (; r + 8 <= rows; r += 8) {
+		__m256 acc = _mm256_setzero_ps();
+		for (int c = 0; c < cols; ++c) {
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(weights + (size_t)c * rows + r), _mm256_set1_ps(x[c])));
+		}
+		_mm256_storeu_ps(out + r, acc);
+	}
+	return r;
+}
+
+static int DenseMatVecSSE(const float* weights, const float* x, int rows, int cols, float* out) {
+	int r = 0;
+	for (; r + 4 <= rows; r += 4) {
+		__m128 acc = _mm_setzero_ps();
+		for (int c = 0; c < cols; ++c) {
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(weights + (size_t)c * rows + r), _mm_set1_ps(x[c])));
+		}
+		_mm_storeu_ps(out + r, acc);
+	}
+	return r;
+}
+
+NEAT_TARGET_AVX2 static int DotInt8Int16AVX2(const signed char* weights, const short* x, int count, int& i) {
+	__m256i acc = _mm256_setzero_si256();
+	for (; i + 16 <= count; i += 16) {
+		const __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(weights + i)));
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(w, _mm256_loadu_si256((const __m256i*)(x + i))));
+	}
+	__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+}
+
+static int DotInt8Int16SSE(const signed char* weights, const short* x, int count, int& i) {
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8) {
+		const __m128i w8 = _mm_loadl_epi64((const __m128i*)(weights + i));
+		const __m128i w = _mm_srai_epi16(_mm_unpacklo_epi8(w8, w8), 8); // sign extend to 16 bits
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(w, _mm_loadu_si128((const __m128i*)(x + i))));
+	}
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(acc);
+}
+#endif
+
+#ifdef NEAT_SIMD_NEON
+static int DotInt8Int16NEON(const signed char* weights, const short* x, int count, int& i) {
+	int32x4_t acc = vdupq_n_s32(0);
+	for (; i + 8 <= count; i += 8) {
+		const int16x8_t w = vmovl_s8(vld1_s8(weights + i));
+		const int16x8_t v = vld1q_s16(x + i);
+		acc = vmlal_s16(acc, vget_low_s16(w), vget_low_s16(v));
+		acc = vmlal_s16(acc, vget_high_s16(w), vget_high_s16(v));
+	}
+	return vaddvq_s32(acc);
+}
+
+static int DenseMatVecNEON(const float* weights, const float* x, int rows, int cols, float* out) {
+	int r = 0;
+	for (; r + 4 <= rows; r += 4) {
+		float32x4_t acc = vdupq_n_f32(0.f);
+		for (int c = 0; c < cols; ++c) {
+			acc = vaddq_f32(acc, vmulq_f32(vld1q_f32(weights + (size_t)c * rows + r), vdupq_n_f32(x[c])));
+		}
+		vst1q_f32(out + r, acc);
+	}
+	return r;
+}
+#endif
+
+void NEATSIMD::DenseMatVec(const float* weights, const float* x, int rows, int cols, float* out) {
+	int r = 0;
+	switch (GetLevel()) {
+#ifdef NEAT_SIMD_X86
+	case Level::AVX2: r = DenseMatVecAVX2(weights, x, rows, cols, out); break;
+	case Level::SSE: r = DenseMatVecSSE(weights, x, rows, cols, out); break;
+#endif
+#ifdef NEAT_SIMD_NEON
+	case Level::NEON: r = DenseMatVecNEON(weights, x, rows, cols, out); break;
+#endif
+	default: break;
+	}
+
+	for (; r < rows; ++r) {
+		float sum = 0;
+		for (int c = 0; c < cols; ++c) {
+			sum += weights[(size_t)c * rows + r] * x[c];
+		}
+		out[r] = sum;
+	}
+}
+
+int NEATSIMD::DotInt8Int16(const signed char* weights, const short* x, int count) {
+	int i = 0;
+	int sum = 0;
+	switch (GetLevel()) {
+#ifdef NEAT_SIMD_X86
+	case Level::AVX2: sum = DotInt8Int16AVX2(weights, x, count, i); break;
+	case Level::SSE: sum = DotInt8Int16SSE(weights, x, count, i); break;
+#endif
+#ifdef NEAT_SIMD_NEON
+	case Level::NEON: sum = DotInt8Int16NEON(weights, x, count, i); break;
+#endif
+	default: break;
+	}
+
+	for (; i < count; ++i) {
+		sum += weights[i] * x[i];
+	}
+	return sum;
+}
@@ -0,0 +1,64 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+// platform detection shared by the vectorized kernels
+#if defined(__x86_64__) || defined(_M_X64)
+#define NEAT_SIMD_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define NEAT_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang need the target attribute to emit AVX2 instructions without compiling the whole file with -mavx2
+// (fma is deliberately left out so that the vector kernels round exactly like the scalar fallbacks)
+#if defined(NEAT_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define NEAT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NEAT_TARGET_AVX2
+#endif
+
+namespace NEATSIMD {
+	enum class Level {
+		Scalar,
+		SSE, // SSE2 (always available on x86-64)
+		AVX2,
+		NEON
+	};
+
+	// best instruction set supported by the running CPU (detected once)
+	Level GetLevel();
+
+	const char* GetLevelName(Level level);
+
+	// out[r] = sum over c of weights[c * rows + r] * x[c] (weights are column-major)
+	// each row is accumulated in column order, so every SIMD level gives bit-identical results
+	void DenseMatVec(const float* weights, const float* x, int rows, int cols, float* out);
+
+	// sum over i of weights[i] * x[i] (exact integer arithmetic, so every SIMD level gives the same result)
+	// the 32-bit accumulators can't overflow as long as count is below ~250k
+	int DotInt8Int16(const signed char* weights, const short* x, int count);
+}
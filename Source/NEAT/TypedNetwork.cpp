@@ -0,0 +1,100 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "TypedNetwork.h"
+
+template<typename Weight, typename Value>
+TypedNetwork<Weight, Value>::TypedNetwork(const NetworkBase& network) {
+	if (network.IsInvalid()) {
+		std::cerr << "Failed to initialize TypedNetwork since the network is invalid" << std::endl;
+		return;
+	}
+
+	num_input_nodes = network.num_input_nodes;
+	num_output_nodes = network.num_output_nodes;
+	input_counts = network.input_counts;
+	output_indices = network.output_indices;
+	node_activations = network.node_activations;
+
+	// the weights come from input_info (not the half precision copy) so that every instantiation starts from the saved weights
+	std::vector<int> new_input_indices;
+	std::vector<Weight> new_weights;
+	new_input_indices.reserve(network.input_info->size());
+	new_weights.reserve(network.input_info->size());
+	for (auto& e : *network.input_info) {
+		new_input_indices.emplace_back(e.input_index);
+		new_weights.emplace_back(NEATScalar<Weight>::FromDouble(e.weight));
+	}
+	input_indices = MakeSharedNetworkArray(std::move(new_input_indices));
+	weights = MakeSharedNetworkArray(std::move(new_weights));
+
+	ResetRecurrentConnections();
+}
+
+template<typename Weight, typename Value>
+bool TypedNetwork<Weight, Value>::IsInvalid() const {
+	return num_input_nodes < 2 || num_output_nodes < 1;
+}
+
+template<typename Weight, typename Value>
+void TypedNetwork<Weight, Value>::ResetRecurrentConnections() {
+	if (IsInvalid()) return;
+	node_vals.assign(input_counts->size(), 0); // resets all neuron outputs to 0
+}
+
+template<typename Weight, typename Value>
+int TypedNetwork<Weight, Value>::GetNumWeightBytes() const {
+	return weights ? weights->size() * sizeof(Weight) : 0;
+}
+
+template<typename Weight, typename Value>
+void TypedNetwork<Weight, Value>::RunNodes() {
+	node_vals[num_input_nodes - 1] = 1; // bias always set to 1
+
+	// nodes are evaluated in order with the same summation order as NetworkBase::Run
+	const int* prevIndices = input_indices->data();
+	const Weight* prevWeights = weights->data();
+	const int numNodes = input_counts->size();
+	for (int i = 0; i < numNodes; ++i) {
+		const int numPrevNodes = (*input_counts)[i];
+		if (i < num_input_nodes) {
+			prevIndices += numPrevNodes;
+			prevWeights += numPrevNodes;
+			continue;
+		}
+
+		Value sum = 0;
+		for (int j = 0; j < numPrevNodes; ++j) {
+			sum += node_vals[prevIndices[j]] * (Value)NEATScalar<Weight>::ToArithmetic(prevWeights[j]);
+		}
+		prevIndices += numPrevNodes;
+		prevWeights += numPrevNodes;
+
+		node_vals[i] = NEATActivation::Apply((*node_activations)[i], sum);
+	}
+}
+
+template class TypedNetwork<float, float>;
+template class TypedNetwork<double, double>;
+template class TypedNetwork<NEATHalf, float>;
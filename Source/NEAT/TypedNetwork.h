@@ -0,0 +1,134 @@
+/*
+ MIT License
+
+ Copyright (c) 2024 Allan Chew
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include "Network.h"
+#include "MathHelpers.h"
+
+// IEEE half precision value (only used for storage; arithmetic is done after converting to float)
+struct NEATHalf {
+	unsigned short bits = 0;
+};
+
+// conversions between the scalar types that TypedNetwork can be instantiated with
+template<typename T>
+struct NEATScalar {
+	using Arithmetic = T; // type that values get converted to before doing math with them
+	static T FromDouble(double val) { return (T)val; }
+	static double ToDouble(T val) { return val; }
+	static Arithmetic ToArithmetic(T val) { return val; }
+};
+
+template<>
+struct NEATScalar<NEATHalf> {
+	using Arithmetic = float;
+	static NEATHalf FromDouble(double val) { NEATHalf h; h.bits = NEATMathHelpers::FloatToHalf((float)val); return h; }
+	static double ToDouble(NEATHalf val) { return NEATMathHelpers::HalfToFloat(val.bits); }
+	static Arithmetic ToArithmetic(NEATHalf val) { return NEATMathHelpers::HalfToFloat(val.bits); }
+};
+
+// copy of a NetworkBase with its weights stored as Weight and its node outputs (including the recurrent state) and sums as Value
+// instantiated for <float, float> (same results as NetworkBase::Run), <double, double> (for long recurrent rollouts where float drifts)
+// and <NEATHalf, float> (half the weight bandwidth with float accumulation)
+// networks can be converted between instantiations, which converts the weights (the topology is shared)
+template<typename Weight, typename Value>
+class TypedNetwork {
+	template<typename W, typename V> friend class TypedNetwork;
+public:
+	TypedNetwork() {}
+	explicit TypedNetwork(const NetworkBase& network);
+
+	template<typename OtherWeight, typename OtherValue>
+	explicit TypedNetwork(const TypedNetwork<OtherWeight, OtherValue>& other)
+		: num_input_nodes{ other.num_input_nodes }, num_output_nodes{ other.num_output_nodes },
+		input_counts{ other.input_counts }, input_indices{ other.input_indices },
+		output_indices{ other.output_indices }, node_activations{ other.node_activations } {
+		std::vector<Weight> new_weights;
+		new_weights.reserve(other.weights->size());
+		for (auto& e : *other.weights) {
+			new_weights.emplace_back(NEATScalar<Weight>::FromDouble(NEATScalar<OtherWeight>::ToDouble(e)));
+		}
+		weights = MakeSharedNetworkArray(std::move(new_weights));
+		ResetRecurrentConnections();
+	}
+
+	bool IsInvalid() const;
+
+	void ResetRecurrentConnections();
+
+	int GetNumWeightBytes() const; // for debugging
+
+	template<typename T, typename U>
+	bool Run(const std::vector<T>& in, std::vector<U>& out) {
+		if (IsInvalid()) {
+			std::cerr << "Run failed since TypedNetwork hasn't been initialized" << std::endl;
+			return false;
+		}
+
+		if ((int)in.size() != (num_input_nodes - 1)) {
+			std::cerr << "TypedNetwork::Run received input vector with incorrect size" << std::endl;
+			return false;
+		}
+
+		if ((int)out.size() != num_output_nodes) {
+			std::cerr << "TypedNetwork::Run received output vector with incorrect size" << std::endl;
+			return false;
+		}
+
+		for (int i = 0; i < (num_input_nodes - 1); ++i) {
+			node_vals[i] = (Value)in[i];
+		}
+
+		RunNodes();
+
+		for (int i = 0; i < num_output_nodes; ++i) {
+			out[i] = (U)node_vals[(*output_indices)[i]];
+		}
+
+		return true;
+	}
+
+private:
+	int num_input_nodes = 0;
+	int num_output_nodes = 0;
+
+	// topology is shared between copies and conversions
+	SharedNetworkArray<int> input_counts;
+	SharedNetworkArray<int> input_indices;
+	SharedNetworkArray<int> output_indices;
+	SharedNetworkArray<NEATActivation::Type> node_activations;
+	SharedNetworkArray<Weight> weights;
+
+	std::vector<Value> node_vals;
+
+	void RunNodes(); // helper for Run
+};
+
+// defined in TypedNetwork.cpp
+extern template class TypedNetwork<float, float>;
+extern template class TypedNetwork<double, double>;
+extern template class TypedNetwork<NEATHalf, float>;
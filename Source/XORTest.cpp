@@ -25,6 +25,7 @@
 #include "XORTest.h"
 #include "./NEAT/NEAT.h"
 #include "./NEAT/MathHelpers.h"
+#include "./NEAT/PopulationEvaluator.h"
 #include <iostream>
 
 // solution to XOR (used to calculate fitness)
@@ -67,18 +68,25 @@ NetworkBaseVisual XORTest::Tick() {
 
 	// set fitnesses for each organism
 	std::vector<float> out = { 0 }; // vector for holding output result
-	auto generatedNetworks = xorNEAT.GenerateNetworks();
+	auto generatedNetworks = xorNEAT.GenerateLeanNetworks(); // only the best network gets visualized (see below)
 	xorNEAT.PrintSpecieInfo();
 	std::cout << "generation id = " << xorNEAT.GetGenerationID() << ", numSpecies = " << xorNEAT.GetNumSpecies() << ", numNetworks = " << generatedNetworks.size() << std::endl;
+
+	// every network sees the same input sequence, so the whole population can be run in lockstep
+	PopulationEvaluator population(generatedNetworks);
+	std::vector<float> population_out; // one output per network
+	std::vector<float> errors(generatedNetworks.size(), 0);
+	for (auto& e : input_indices) {
+		population.Run(inputs[e], population_out);
+		for (int i = 0; i < (int)generatedNetworks.size(); ++i) {
+			errors[i] += abs(outputs[e] - population_out[i]);
+		}
+	}
+
 	float max_fitness = 0;
 	int max_fitness_index = 0;
 	for (int i = 0; i < generatedNetworks.size(); ++i) {
-		float fitness = 0;
-		for (auto& e : input_indices) {
-			std::get<0>(generatedNetworks[i]).Run(inputs[e], out);
-			fitness += abs(outputs[e] - out[0]);
-		}
-		fitness = (max_error - fitness) / max_error;
+		const float fitness = (max_error - errors[i]) / max_error;
 		std::get<1>(generatedNetworks[i]).SetFitness(fitness);
 
 		// keep track of organism with highest fitness
@@ -104,7 +112,8 @@ NetworkBaseVisual XORTest::Tick() {
 	std::get<0>(generatedNetworks[max_fitness_index]).Run(inputs[3], out);
 	std::cout << "{1,1} => " << out[0] << std::endl;
 
+	NetworkBaseVisual best_network = xorNEAT.GenerateVisualNetwork(max_fitness_index); // (has to be generated before the organisms get replaced)
 	xorNEAT.UpdateGeneration();
 
-	return std::get<0>(generatedNetworks[max_fitness_index]); // return network of organism with highest fitness for visualization
+	return best_network; // return network of organism with highest fitness for visualization
 }